@@ -0,0 +1,172 @@
+// Connection churn against a server, with and without the pool for accepted clients.
+// Short-lived connections are opened by plain blocking sockets, each sending one byte
+// that the server echoes. Meanwhile, the server side keeps a few small long-lived
+// allocations, like an application would, which pins heap blocks between the clients.
+//
+// Reports the time from connect() until the echo arrives and the state of the heap
+// after all connections are gone. Each configuration runs in its own process so they
+// start with the same heap.
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <deque>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <malloc.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <AsyncTCP.h>
+
+using namespace std::chrono_literals;
+
+namespace {
+
+constexpr std::uint16_t PORT = 47002;
+constexpr std::size_t CONNECTIONS = 5000;
+// Connections open at the same time
+constexpr std::size_t WINDOW = 32;
+// Every n-th connection leaves a long-lived allocation behind
+constexpr std::size_t RETAIN_EVERY = 8;
+
+struct HeapStats {
+    std::size_t size;
+    std::size_t free;
+};
+
+HeapStats heapStats() {
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+    const struct mallinfo2 info = mallinfo2();
+    return HeapStats{info.arena, info.fordblks};
+#else
+    return HeapStats{0, 0};
+#endif
+}
+
+int connectBlocking() {
+    const int socket = ::socket(AF_INET, SOCK_STREAM, 0);
+    const int one = 1;
+    setsockopt(socket, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    const sockaddr_in addr{.sin_family = AF_INET,
+                           .sin_port = htons(PORT),
+                           .sin_addr = {.s_addr = htonl(INADDR_LOOPBACK)},
+                           .sin_zero = {}};
+    if (::connect(socket, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) < 0) {
+        ::close(socket);
+        return -1;
+    }
+    return socket;
+}
+
+void run(std::size_t poolSize) {
+    AsyncClient::pool().setCapacity(poolSize);
+
+    std::atomic<std::size_t> alive = 0;
+    std::size_t accepted = 0;
+    // Only touched by the manager task
+    std::vector<std::unique_ptr<std::array<char, 64>>> retained;
+    retained.reserve(CONNECTIONS / RETAIN_EVERY);
+
+    AsyncServer server(PORT);
+    server.onClient(
+        [&](void*, AsyncClient* c) {
+            ++alive;
+            if (++accepted % RETAIN_EVERY == 0) {
+                retained.push_back(std::make_unique<std::array<char, 64>>());
+            }
+
+            c->setNoDelay(true);
+            // Some per-connection state of varying size
+            auto* state = new std::string(128 + (accepted % 16) * 64, 'x');
+            c->onData(
+                [](void*, AsyncClient* c, void* data, std::size_t len) {
+                    c->write(static_cast<const char*>(data), len);
+                },
+                state);
+            c->onDisconnect(
+                [&alive, state](void*, AsyncClient* c) {
+                    delete state;
+                    --alive;
+                    // Destroys this lambda as well
+                    delete c;
+                },
+                nullptr);
+        },
+        nullptr);
+    server.begin();
+
+    std::vector<double> latencies;
+    latencies.reserve(CONNECTIONS);
+    std::deque<int> open;
+
+    for (std::size_t i = 0; i < CONNECTIONS; ++i) {
+        if (open.size() == WINDOW) {
+            ::close(open.front());
+            open.pop_front();
+        }
+
+        const auto start = std::chrono::steady_clock::now();
+        const int socket = connectBlocking();
+        char byte = 'a';
+        if (socket < 0 || ::send(socket, &byte, 1, 0) != 1 ||
+            ::recv(socket, &byte, 1, 0) != 1) {
+            std::printf("%10zu  connection %zu failed\n", poolSize, i);
+            return;
+        }
+        latencies.push_back(std::chrono::duration<double, std::micro>(
+                                std::chrono::steady_clock::now() - start)
+                                .count());
+        open.push_back(socket);
+    }
+
+    for (int socket : open) {
+        ::close(socket);
+    }
+
+    const auto deadline = std::chrono::steady_clock::now() + 10s;
+    while (alive != 0 && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(1ms);
+    }
+
+    std::sort(latencies.begin(), latencies.end());
+    double sum = 0;
+    for (double latency : latencies) {
+        sum += latency;
+    }
+
+    const HeapStats heap = heapStats();
+    std::printf("%10zu  %14.1f  %14.1f  %11zu  %15zu\n", poolSize, sum / latencies.size(),
+                latencies[latencies.size() * 99 / 100], heap.size / 1024,
+                heap.free / 1024);
+}
+
+}  // namespace
+
+int main() {
+    std::printf("%10s  %14s  %14s  %11s  %15s\n", "pool size", "avg first [us]",
+                "p99 first [us]", "heap [KiB]", "free heap [KiB]");
+    std::fflush(stdout);
+
+    for (std::size_t poolSize : {std::size_t(0), WINDOW * 2}) {
+        // The manager task must not exist before fork()
+        const pid_t child = fork();
+        if (child == 0) {
+            run(poolSize);
+            std::fflush(stdout);
+            _exit(0);
+        }
+        waitpid(child, nullptr, 0);
+    }
+
+    return 0;
+}
@@ -0,0 +1,122 @@
+// Cost of one iteration of the manager task depending on the number of mostly-idle
+// clients. One client ping-pongs small messages with an echo server over loopback while
+// all other clients stay connected but idle.
+//
+// Reports the average round trip time of the active client and the CPU time the process
+// spends per second while all clients are idle.
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <ctime>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <AsyncTCP.h>
+
+using namespace std::chrono_literals;
+
+namespace {
+
+constexpr std::uint16_t PORT = 47001;
+constexpr int ROUND_TRIPS = 2000;
+constexpr std::size_t MESSAGE_SIZE = 8;
+
+template <class Predicate>
+bool waitFor(Predicate&& predicate, std::chrono::steady_clock::duration timeout = 10s) {
+    const auto deadline = std::chrono::steady_clock::now() + timeout;
+    while (!predicate()) {
+        if (std::chrono::steady_clock::now() > deadline) {
+            return false;
+        }
+        std::this_thread::sleep_for(1ms);
+    }
+    return true;
+}
+
+std::chrono::nanoseconds processCpuTime() {
+    timespec ts{};
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return std::chrono::seconds(ts.tv_sec) + std::chrono::nanoseconds(ts.tv_nsec);
+}
+
+void run(AsyncServer& server, std::size_t clientCount) {
+    std::atomic<std::size_t> accepted = 0;
+    std::atomic<std::size_t> connected = 0;
+
+    server.onClient(
+        [&](void*, AsyncClient* c) {
+            c->setNoDelay(true);
+            c->onData([](void*, AsyncClient* c, void* data, std::size_t len) {
+                c->write(static_cast<const char*>(data), len);
+            });
+            c->onDisconnect([](void*, AsyncClient* c) { delete c; });
+            ++accepted;
+        },
+        nullptr);
+
+    std::vector<std::unique_ptr<AsyncClient>> clients;
+    for (std::size_t i = 0; i < clientCount; ++i) {
+        auto& client = clients.emplace_back(std::make_unique<AsyncClient>());
+        client->onConnect([&](void*, AsyncClient* c) {
+            c->setNoDelay(true);
+            ++connected;
+        });
+        client->connect(IPAddress(127, 0, 0, 1), PORT);
+    }
+
+    if (!waitFor([&] { return connected == clientCount && accepted == clientCount; })) {
+        std::printf("%8zu  failed to connect (%zu/%zu)\n", clientCount, connected.load(),
+                    accepted.load());
+        return;
+    }
+
+    // Let everything settle before measuring
+    std::this_thread::sleep_for(300ms);
+
+    const auto idleStart = processCpuTime();
+    std::this_thread::sleep_for(1s);
+    const auto idleCpu = processCpuTime() - idleStart;
+
+    std::atomic<int> remaining = ROUND_TRIPS;
+    static constexpr char message[MESSAGE_SIZE] = "ping!!!";
+    clients.front()->onData([&](void*, AsyncClient* c, void*, std::size_t) {
+        if (--remaining > 0) {
+            c->write(message, MESSAGE_SIZE);
+        }
+    });
+
+    const auto start = std::chrono::steady_clock::now();
+    clients.front()->write(message, MESSAGE_SIZE);
+    const bool finished = waitFor([&] { return remaining <= 0; }, 60s);
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+
+    if (finished) {
+        std::printf(
+            "%8zu  %16.1f  %18.2f\n", clientCount,
+            std::chrono::duration<double, std::micro>(elapsed).count() / ROUND_TRIPS,
+            std::chrono::duration<double, std::milli>(idleCpu).count());
+    } else {
+        std::printf("%8zu  timed out after %d round trips\n", clientCount,
+                    ROUND_TRIPS - remaining.load());
+    }
+
+    clients.front()->onData(nullptr);
+    clients.clear();
+    std::this_thread::sleep_for(300ms);
+}
+
+}  // namespace
+
+int main() {
+    AsyncServer server(PORT);
+    server.begin();
+
+    std::printf("%8s  %16s  %18s\n", "clients", "round trip [us]", "idle CPU [ms/s]");
+    for (std::size_t clientCount : {1, 100, 1000}) {
+        run(server, clientCount);
+    }
+
+    return 0;
+}
@@ -0,0 +1,115 @@
+// Callbacks through std::function (Client) against the members of a handler known at
+// compile time (StaticClient). A blocking socket ping-pongs small messages with an echo
+// server over loopback, once with a Server accepting into Client and once with a
+// StaticServer accepting into StaticClient<StaticEcho>.
+//
+// Reports the size of both client types and the average round trip time. Must be built
+// with -DASYNC_TCP_STATIC_CLIENT_HANDLERS=benchmark::StaticEcho, see CMakeLists.txt.
+
+#include <chrono>
+#include <cstdio>
+
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <AsyncTCP.h>
+
+namespace {
+
+using StaticEchoClient = AsyncTcpSock::StaticClient<benchmark::StaticEcho>;
+using StaticEchoServer = AsyncTcpSock::StaticServer<benchmark::StaticEcho>;
+
+constexpr std::uint16_t PORT = 47005;
+constexpr int ROUND_TRIPS = 20000;
+constexpr std::size_t MESSAGE_SIZE = 8;
+
+int connectBlocking(std::uint16_t port) {
+    const int socket = ::socket(AF_INET, SOCK_STREAM, 0);
+    const int one = 1;
+    setsockopt(socket, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    const sockaddr_in addr{.sin_family = AF_INET,
+                           .sin_port = htons(port),
+                           .sin_addr = {.s_addr = htonl(INADDR_LOOPBACK)},
+                           .sin_zero = {}};
+    if (::connect(socket, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) < 0) {
+        ::close(socket);
+        return -1;
+    }
+    return socket;
+}
+
+// Average round trip in microseconds, or a negative value on failure
+double pingPong(std::uint16_t port) {
+    const int socket = connectBlocking(port);
+    if (socket < 0) {
+        return -1;
+    }
+
+    char message[MESSAGE_SIZE] = "ping";
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < ROUND_TRIPS; ++i) {
+        if (::send(socket, message, sizeof(message), 0) != sizeof(message)) {
+            ::close(socket);
+            return -1;
+        }
+
+        std::size_t received = 0;
+        while (received < sizeof(message)) {
+            const ssize_t result =
+                ::recv(socket, message + received, sizeof(message) - received, 0);
+            if (result <= 0) {
+                ::close(socket);
+                return -1;
+            }
+            received += result;
+        }
+    }
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+
+    ::close(socket);
+    return std::chrono::duration<double, std::micro>(elapsed).count() / ROUND_TRIPS;
+}
+
+void report(const char* name, std::size_t size, double roundTrip) {
+    if (roundTrip < 0) {
+        std::printf("%12s  %12zu  %14s\n", name, size, "failed");
+    } else {
+        std::printf("%12s  %12zu  %14.2f\n", name, size, roundTrip);
+    }
+    std::fflush(stdout);
+}
+
+}  // namespace
+
+int main() {
+    std::printf("%12s  %12s  %14s\n", "client", "size [bytes]", "round trip [us]");
+    std::fflush(stdout);
+
+    {
+        AsyncServer server(PORT);
+        server.onClient(
+            [](void*, AsyncClient* c) {
+                c->onData(
+                    [](void*, AsyncClient* c, void* data, std::size_t len) {
+                        c->write(static_cast<const char*>(data), len);
+                    },
+                    nullptr);
+                c->onDisconnect([](void*, AsyncClient* c) { delete c; }, nullptr);
+            },
+            nullptr);
+        server.begin();
+        report("Client", sizeof(AsyncClient), pingPong(PORT));
+    }
+
+    {
+        StaticEchoServer server(PORT + 1);
+        server.onClient([](void*, StaticEchoClient*) {}, nullptr);
+        server.begin();
+        report("StaticClient", sizeof(StaticEchoClient), pingPong(PORT + 1));
+    }
+
+    return 0;
+}
@@ -0,0 +1,28 @@
+// Handler of the StaticClient benchmark, listed in ASYNC_TCP_STATIC_CLIENT_HANDLERS by
+// its build
+
+#ifndef ASYNCTCPSOCK_BENCHMARKS_STATICCLIENTECHO_HPP
+#define ASYNCTCPSOCK_BENCHMARKS_STATICCLIENTECHO_HPP
+
+#include <cstddef>
+
+#include <StaticClient.hpp>
+
+namespace benchmark {
+
+// Sends back what it receives
+struct StaticEcho {
+    void onData(AsyncTcpSock::StaticClient<StaticEcho>* client,
+                void* data,
+                std::size_t len) {
+        client->write(static_cast<const char*>(data), len);
+    }
+
+    void onDisconnect(AsyncTcpSock::StaticClient<StaticEcho>* client) {
+        delete client;
+    }
+};
+
+}  // namespace benchmark
+
+#endif
@@ -0,0 +1,170 @@
+// Several threads writing small messages to one connection, with the write queue behind
+// its mutex and with lock-free writes. A plain blocking socket on another thread reads
+// everything on the other end of a loopback connection.
+//
+// Reports the throughput and how long the producers spend in each write() call,
+// including calls that found the queue full. Each configuration runs in its own process
+// so that they start with a fresh manager task.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <AsyncTCP.h>
+
+using namespace std::chrono_literals;
+
+namespace {
+
+constexpr std::uint16_t PORT = 47004;
+constexpr std::size_t PRODUCERS = 4;
+constexpr std::size_t MESSAGES = 100000;
+constexpr std::size_t MESSAGE_SIZE = 64;
+constexpr std::size_t TOTAL = PRODUCERS * MESSAGES * MESSAGE_SIZE;
+
+template <class Predicate>
+bool waitFor(Predicate&& predicate, std::chrono::steady_clock::duration timeout = 10s) {
+    const auto deadline = std::chrono::steady_clock::now() + timeout;
+    while (!predicate()) {
+        if (std::chrono::steady_clock::now() > deadline) {
+            return false;
+        }
+        std::this_thread::sleep_for(1ms);
+    }
+    return true;
+}
+
+int listenBlocking() {
+    const int socket = ::socket(AF_INET, SOCK_STREAM, 0);
+    const int one = 1;
+    setsockopt(socket, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    const sockaddr_in addr{.sin_family = AF_INET,
+                           .sin_port = htons(PORT),
+                           .sin_addr = {.s_addr = htonl(INADDR_LOOPBACK)},
+                           .sin_zero = {}};
+    if (::bind(socket, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) < 0 ||
+        ::listen(socket, 1) < 0) {
+        ::close(socket);
+        return -1;
+    }
+    return socket;
+}
+
+void run(bool lockFree) {
+    const char* name = lockFree ? "lock-free" : "mutex";
+
+    const int listener = listenBlocking();
+    if (listener < 0) {
+        std::printf("%10s  failed to listen\n", name);
+        return;
+    }
+
+    std::atomic<std::size_t> received = 0;
+    std::thread sink([&] {
+        const int socket = ::accept(listener, nullptr, nullptr);
+        std::vector<char> buffer(65536);
+        while (received < TOTAL) {
+            const ssize_t result = ::recv(socket, buffer.data(), buffer.size(), 0);
+            if (result <= 0) {
+                break;
+            }
+            received += result;
+        }
+        ::close(socket);
+    });
+
+    AsyncClient client;
+    client.setLockFreeWrites(lockFree);
+    client.setNoDelay(true);
+    client.connect(IPAddress(127, 0, 0, 1), PORT);
+    if (!waitFor([&] { return client.connected(); })) {
+        std::printf("%10s  failed to connect\n", name);
+        ::shutdown(listener, SHUT_RDWR);
+        sink.join();
+        ::close(listener);
+        return;
+    }
+
+    std::vector<std::vector<double>> latencies(PRODUCERS);
+    std::vector<std::thread> producers;
+    const auto start = std::chrono::steady_clock::now();
+    for (std::size_t p = 0; p < PRODUCERS; ++p) {
+        latencies[p].reserve(MESSAGES * 2);
+        producers.emplace_back([&, p] {
+            std::vector<char> message(MESSAGE_SIZE, static_cast<char>('a' + p));
+            for (std::size_t i = 0; i < MESSAGES; ++i) {
+                std::size_t offset = 0;
+                while (offset < MESSAGE_SIZE) {
+                    const auto before = std::chrono::steady_clock::now();
+                    offset +=
+                        client.write(message.data() + offset, MESSAGE_SIZE - offset);
+                    const auto after = std::chrono::steady_clock::now();
+                    latencies[p].push_back(
+                        std::chrono::duration<double, std::nano>(after - before).count());
+                    if (offset < MESSAGE_SIZE) {
+                        std::this_thread::yield();
+                    }
+                }
+            }
+        });
+    }
+    for (std::thread& producer : producers) {
+        producer.join();
+    }
+
+    const bool complete = waitFor([&] { return received == TOTAL; });
+    const double seconds =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    client.close();
+    ::shutdown(listener, SHUT_RDWR);
+    sink.join();
+    ::close(listener);
+
+    if (!complete) {
+        std::printf("%10s  received %zu of %zu bytes\n", name, received.load(), TOTAL);
+        return;
+    }
+
+    std::vector<double> all;
+    for (const std::vector<double>& producer : latencies) {
+        all.insert(all.end(), producer.begin(), producer.end());
+    }
+    std::sort(all.begin(), all.end());
+    double sum = 0;
+    for (double latency : all) {
+        sum += latency;
+    }
+
+    std::printf("%10s  %12.1f  %12.1f  %12.1f  %12.1f\n", name, TOTAL / seconds / 1e6,
+                sum / all.size(), all[all.size() / 2], all[all.size() * 99 / 100]);
+}
+
+}  // namespace
+
+int main() {
+    std::printf("%10s  %12s  %12s  %12s  %12s\n", "mode", "[MB/s]", "avg [ns]",
+                "p50 [ns]", "p99 [ns]");
+    std::fflush(stdout);
+
+    for (bool lockFree : {false, true}) {
+        // The manager task must not exist before fork()
+        const pid_t child = fork();
+        if (child == 0) {
+            run(lockFree);
+            std::fflush(stdout);
+            _exit(0);
+        }
+        waitpid(child, nullptr, 0);
+    }
+
+    return 0;
+}
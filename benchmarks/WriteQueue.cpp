@@ -0,0 +1,84 @@
+// Containers for the write queue of a client: std::vector with erase() from the front,
+// std::deque and RingBuffer with pop_front(). Each round queues a batch of buffers at
+// the back and removes a batch of finished ones from the front, as the client does,
+// while the queue holds a steady number of further buffers.
+//
+// Reports the time per queued and removed buffer.
+
+#include <chrono>
+#include <cstdio>
+#include <deque>
+#include <vector>
+
+#include <RingBuffer.hpp>
+#include <WriteQueueBuffer.hpp>
+
+using AsyncTcpSock::BorrowedWriteQueueBuffer;
+using AsyncTcpSock::RingBuffer;
+using AsyncTcpSock::WriteQueueBuffer;
+
+namespace {
+
+constexpr std::size_t OPERATIONS = 4'000'000;
+constexpr std::size_t BATCH = 4;
+
+const std::uint8_t DATA[64]{};
+// Taken once so that the clock doesn't dominate the measurement
+const auto QUEUED_AT = std::chrono::steady_clock::now();
+
+WriteQueueBuffer makeBuffer() {
+    return BorrowedWriteQueueBuffer{{.queuedAt = QUEUED_AT},
+                                    std::span<const std::uint8_t>(DATA)};
+}
+
+template <class Queue>
+void removeFront(Queue& queue, std::size_t count) {
+    if constexpr (requires { queue.pop_front(); }) {
+        for (std::size_t i = 0; i < count; ++i) {
+            queue.pop_front();
+        }
+    } else {
+        queue.erase(queue.begin(), queue.begin() + count);
+    }
+}
+
+template <class Queue>
+double measure(std::size_t depth) {
+    Queue queue;
+    for (std::size_t i = 0; i < depth; ++i) {
+        queue.push_back(makeBuffer());
+    }
+
+    std::size_t checksum = 0;
+    const auto start = std::chrono::steady_clock::now();
+    for (std::size_t i = 0; i < OPERATIONS / BATCH; ++i) {
+        for (std::size_t j = 0; j < BATCH; ++j) {
+            queue.push_back(makeBuffer());
+        }
+        checksum += queue.size();
+        removeFront(queue, BATCH);
+    }
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+
+    // Keep the loop from being optimized away
+    if (checksum == 0) {
+        std::printf("unexpected\n");
+    }
+
+    return std::chrono::duration<double, std::nano>(elapsed).count() / OPERATIONS;
+}
+
+}  // namespace
+
+int main() {
+    std::printf("%8s  %14s  %14s  %14s\n", "depth", "vector [ns]", "deque [ns]",
+                "ring [ns]");
+    for (std::size_t depth : {0, 4, 16, 64, 256}) {
+        std::printf("%8zu  %14.1f  %14.1f  %14.1f\n", depth,
+                    measure<std::vector<WriteQueueBuffer>>(depth),
+                    measure<std::deque<WriteQueueBuffer>>(depth),
+                    measure<RingBuffer<WriteQueueBuffer>>(depth));
+    }
+
+    return 0;
+}
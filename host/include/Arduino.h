@@ -0,0 +1,75 @@
+#ifndef ASYNCTCPSOCK_HOST_ARDUINO_H
+#define ASYNCTCPSOCK_HOST_ARDUINO_H
+
+// Just enough of the Arduino core to run the examples on a POSIX host.
+
+#include <chrono>
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+
+#include "Platform.hpp"
+
+using String = std::string;
+
+#define F(str) (str)
+
+inline std::uint32_t millis() {
+    static const auto start = std::chrono::steady_clock::now();
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+               std::chrono::steady_clock::now() - start)
+        .count();
+}
+
+inline void delay(std::uint32_t ms) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+class HostSerial {
+  public:
+    void begin(unsigned long) {
+    }
+
+    explicit operator bool() const {
+        return true;
+    }
+
+    std::size_t write(const std::uint8_t* data, std::size_t size) {
+        const std::size_t written = std::fwrite(data, 1, size, stdout);
+        std::fflush(stdout);
+        return written;
+    }
+
+    std::size_t print(const char* str) {
+        return write(reinterpret_cast<const std::uint8_t*>(str), std::strlen(str));
+    }
+
+    std::size_t print(const String& str) {
+        return print(str.c_str());
+    }
+
+    std::size_t print(const IPAddress& ip) {
+        return print(ip.toString());
+    }
+
+    template <class T>
+    std::size_t println(const T& value) {
+        return print(value) + print("\r\n");
+    }
+
+    std::size_t printf(const char* format, ...) __attribute__((format(printf, 2, 3))) {
+        va_list args;
+        va_start(args, format);
+        const int written = std::vprintf(format, args);
+        va_end(args);
+        std::fflush(stdout);
+        return written < 0 ? 0 : written;
+    }
+};
+
+inline HostSerial Serial;
+
+#endif
@@ -0,0 +1,42 @@
+#ifndef ASYNCTCPSOCK_HOST_WIFI_H
+#define ASYNCTCPSOCK_HOST_WIFI_H
+
+// The host is always connected. Credentials are ignored.
+
+#include "Arduino.h"
+
+enum wifi_mode_t {
+    WIFI_OFF,
+    WIFI_STA,
+    WIFI_AP,
+    WIFI_AP_STA,
+};
+
+enum wl_status_t {
+    WL_IDLE_STATUS = 0,
+    WL_CONNECTED = 3,
+    WL_DISCONNECTED = 6,
+};
+
+class HostWiFi {
+  public:
+    bool mode(wifi_mode_t) {
+        return true;
+    }
+
+    wl_status_t begin(const char*, const char* = nullptr) {
+        return WL_CONNECTED;
+    }
+
+    wl_status_t status() const {
+        return WL_CONNECTED;
+    }
+
+    IPAddress localIP() const {
+        return IPAddress(127, 0, 0, 1);
+    }
+};
+
+inline HostWiFi WiFi;
+
+#endif
@@ -0,0 +1,12 @@
+// Runs an Arduino sketch on the host: setup() once, then loop() forever.
+
+void setup();
+void loop();
+
+int main() {
+    setup();
+
+    while (true) {
+        loop();
+    }
+}
@@ -41,6 +41,49 @@ template <>
 void unmanage<Server>(Server* conn) {
     AsyncSocketConnectionManager::instance().removeConnection(conn);
 }
+
+template <>
+void watch<Client>(Client* conn, int socket) {
+    AsyncSocketConnectionManager::instance().watchSocket(conn, socket);
+}
+template <>
+void watch<Server>(Server* conn, int socket) {
+    AsyncSocketConnectionManager::instance().watchSocket(conn, socket);
+}
+
+template <>
+void unwatch<Client>(Client* conn, int socket) {
+    AsyncSocketConnectionManager::instance().unwatchSocket(conn, socket);
+}
+template <>
+void unwatch<Server>(Server* conn, int socket) {
+    AsyncSocketConnectionManager::instance().unwatchSocket(conn, socket);
+}
+
+template <>
+void signalDnsFinished<Client>(Client* conn) {
+    AsyncSocketConnectionManager::instance().signalDnsFinished(conn);
+}
+
+template <>
+void signalTimersChanged<Client>(Client* conn) {
+    AsyncSocketConnectionManager::instance().signalTimersChanged(conn);
+}
+
+template <>
+void signalSubmitted<Client>(Client* conn) {
+    AsyncSocketConnectionManager::instance().signalSubmitted(conn);
+}
+
+template <>
+void signalReleased<Client>(Client* conn) {
+    AsyncSocketConnectionManager::instance().signalReleased(conn);
+}
+
+template <>
+void updateInterest<Client>(Client* conn, int socket, bool read, bool write) {
+    AsyncSocketConnectionManager::instance().updateInterest(conn, socket, read, write);
+}
 }  // namespace AsyncTcpSock
 
 // #include <atomic>
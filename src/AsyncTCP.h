@@ -26,16 +26,94 @@
 #pragma once
 
 #include "Client.hpp"
+#include "ClientPool.hpp"
 #include "Server.hpp"
+#include "StaticClient.hpp"
+
+#ifdef ASYNC_TCP_STATIC_CLIENT_HEADER
+#include ASYNC_TCP_STATIC_CLIENT_HEADER
+#endif
 
 static_assert(AsyncTcpSock::ManagedClient<AsyncTcpSock::Client>);
 static_assert(AsyncTcpSock::ManagedServer<AsyncTcpSock::Server>);
 
-using AsyncSocketConnectionManager =
-    AsyncTcpSock::SocketConnectionManager<std::variant<AsyncTcpSock::Client*>,
-                                          std::variant<AsyncTcpSock::Server*>>;
+namespace AsyncTcpSock {
+template <class... Handlers>
+using ManagedClients = std::variant<Client*, StaticClient<Handlers>*...>;
+template <class... Handlers>
+using ManagedServers = std::variant<Server*, StaticServer<Handlers>*...>;
+}  // namespace AsyncTcpSock
+
+using AsyncSocketConnectionManager = AsyncTcpSock::SocketConnectionManager<
+    AsyncTcpSock::ManagedClients<ASYNC_TCP_STATIC_CLIENT_HANDLERS>,
+    AsyncTcpSock::ManagedServers<ASYNC_TCP_STATIC_CLIENT_HANDLERS>>;
+
+namespace AsyncTcpSock {
+// StaticClient and StaticServer are managed like Client and Server, for any handler
+template <class Handler>
+void manage(StaticClient<Handler>* conn) {
+    AsyncSocketConnectionManager::instance().addConnection(conn);
+}
+template <class Handler>
+void manage(StaticServer<Handler>* conn) {
+    AsyncSocketConnectionManager::instance().addConnection(conn);
+}
+
+template <class Handler>
+void unmanage(StaticClient<Handler>* conn) {
+    AsyncSocketConnectionManager::instance().removeConnection(conn);
+}
+template <class Handler>
+void unmanage(StaticServer<Handler>* conn) {
+    AsyncSocketConnectionManager::instance().removeConnection(conn);
+}
+
+template <class Handler>
+void watch(StaticClient<Handler>* conn, int socket) {
+    AsyncSocketConnectionManager::instance().watchSocket(conn, socket);
+}
+template <class Handler>
+void watch(StaticServer<Handler>* conn, int socket) {
+    AsyncSocketConnectionManager::instance().watchSocket(conn, socket);
+}
+
+template <class Handler>
+void unwatch(StaticClient<Handler>* conn, int socket) {
+    AsyncSocketConnectionManager::instance().unwatchSocket(conn, socket);
+}
+template <class Handler>
+void unwatch(StaticServer<Handler>* conn, int socket) {
+    AsyncSocketConnectionManager::instance().unwatchSocket(conn, socket);
+}
+
+template <class Handler>
+void signalDnsFinished(StaticClient<Handler>* conn) {
+    AsyncSocketConnectionManager::instance().signalDnsFinished(conn);
+}
+
+template <class Handler>
+void signalTimersChanged(StaticClient<Handler>* conn) {
+    AsyncSocketConnectionManager::instance().signalTimersChanged(conn);
+}
+
+template <class Handler>
+void signalSubmitted(StaticClient<Handler>* conn) {
+    AsyncSocketConnectionManager::instance().signalSubmitted(conn);
+}
+
+template <class Handler>
+void signalReleased(StaticClient<Handler>* conn) {
+    AsyncSocketConnectionManager::instance().signalReleased(conn);
+}
+
+template <class Handler>
+void updateInterest(StaticClient<Handler>* conn, int socket, bool read, bool write) {
+    AsyncSocketConnectionManager::instance().updateInterest(conn, socket, read, write);
+}
+}  // namespace AsyncTcpSock
 
 using AsyncClient = AsyncTcpSock::Client;
+using AsyncClientPool = AsyncTcpSock::ClientPool;
 using AsyncServer = AsyncTcpSock::Server;
 
 #endif /* ASYNCTCP_H_ */
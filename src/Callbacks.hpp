@@ -3,20 +3,41 @@
 
 #include <cstdint>
 #include <functional>
+#include <type_traits>
 #include <utility>
 
-#include <esp32-hal-log.h>
-
 #include "Configuration.hpp"
+#include "Platform.hpp"
+#include "RecvBuffer.hpp"
 
 namespace AsyncTcpSock {
 
+namespace detail {
+// static_assert(false) in a discarded branch is only accepted since P2593 (GCC 13)
+template <auto>
+inline constexpr bool dependentFalse = false;
+
+// Handlers set at runtime, like std::function, test false while unset. Callable types
+// without such a test are fixed at compile time and always set.
+template <class Handler>
+constexpr bool isSet(const Handler& handler) {
+    if constexpr (std::is_constructible_v<bool, const Handler&>) {
+        return static_cast<bool>(handler);
+    } else {
+        return true;
+    }
+}
+}  // namespace detail
+
 enum class ClientCallbackType : std::uint8_t {
     CONNECT,
     DISCONNECT,
     POLL,
     SENT,
     RECV,
+    RECV_BUFFER,
+    AVAILABLE,
+    WRITABLE,
     ERROR,
     TIMEOUT,
 };
@@ -40,7 +61,14 @@ template <
         std::function<void(ErrorArg arg, Client* client, int errorCode)>,
     class TimeoutArg = void*,
     class TimeoutHandler_ =
-        std::function<void(TimeoutArg arg, Client* client, std::uint32_t delayMillis)>>
+        std::function<void(TimeoutArg arg, Client* client, std::uint32_t delayMillis)>,
+    class BufferArg = void*,
+    class BufferHandler_ =
+        std::function<void(BufferArg arg, Client* client, RecvBuffer buffer)>,
+    class AvailableArg = void*,
+    class AvailableHandler_ = ConnectHandler_,
+    class WritableArg = void*,
+    class WritableHandler_ = ConnectHandler_>
 struct ClientCallbacks {
     using ConnectHandler = ConnectHandler_;
     using DisconnectHandler = DisconnectHandler_;
@@ -49,34 +77,75 @@ struct ClientCallbacks {
     using RecvHandler = RecvHandler_;
     using ErrorHandler = ErrorHandler_;
     using TimeoutHandler = TimeoutHandler_;
+    using BufferHandler = BufferHandler_;
+    using AvailableHandler = AvailableHandler_;
+    using WritableHandler = WritableHandler_;
 
     Client* client;
 
-    ConnectArg connectArg{};
-    ConnectHandler connectHandler{};
+    [[no_unique_address]] ConnectArg connectArg{};
+    [[no_unique_address]] ConnectHandler connectHandler{};
+
+    [[no_unique_address]] DisconnectArg disconnectArg{};
+    [[no_unique_address]] DisconnectHandler disconnectHandler{};
 
-    DisconnectArg disconnectArg{};
-    DisconnectHandler disconnectHandler{};
+    [[no_unique_address]] PollArg pollArg{};
+    [[no_unique_address]] PollHandler pollHandler{};
 
-    PollArg pollArg{};
-    PollHandler pollHandler{};
+    [[no_unique_address]] SentArg sentArg{};
+    [[no_unique_address]] SentHandler sentHandler{};
 
-    SentArg sentArg{};
-    SentHandler sentHandler{};
+    [[no_unique_address]] RecvArg recvArg{};
+    [[no_unique_address]] RecvHandler recvHandler{};
 
-    RecvArg recvArg{};
-    RecvHandler recvHandler{};
+    [[no_unique_address]] ErrorArg errorArg{};
+    [[no_unique_address]] ErrorHandler errorHandler{};
 
-    ErrorArg errorArg{};
-    ErrorHandler errorHandler{};
+    [[no_unique_address]] TimeoutArg timeoutArg{};
+    [[no_unique_address]] TimeoutHandler timeoutHandler{};
 
-    TimeoutArg timeoutArg{};
-    TimeoutHandler timeoutHandler{};
+    [[no_unique_address]] BufferArg bufferArg{};
+    [[no_unique_address]] BufferHandler bufferHandler{};
+
+    [[no_unique_address]] AvailableArg availableArg{};
+    [[no_unique_address]] AvailableHandler availableHandler{};
+
+    [[no_unique_address]] WritableArg writableArg{};
+    [[no_unique_address]] WritableHandler writableHandler{};
 
     ClientCallbacks(Client* c)
         : client(c) {
     }
 
+    /// Whether a handler is set for the event
+    template <ClientCallbackType TYPE>
+    bool has() const {
+        if constexpr (TYPE == ClientCallbackType::CONNECT) {
+            return detail::isSet(connectHandler);
+        } else if constexpr (TYPE == ClientCallbackType::DISCONNECT) {
+            return detail::isSet(disconnectHandler);
+        } else if constexpr (TYPE == ClientCallbackType::POLL) {
+            return detail::isSet(pollHandler);
+        } else if constexpr (TYPE == ClientCallbackType::SENT) {
+            return detail::isSet(sentHandler);
+        } else if constexpr (TYPE == ClientCallbackType::RECV) {
+            return detail::isSet(recvHandler);
+        } else if constexpr (TYPE == ClientCallbackType::RECV_BUFFER) {
+            return detail::isSet(bufferHandler);
+        } else if constexpr (TYPE == ClientCallbackType::AVAILABLE) {
+            return detail::isSet(availableHandler);
+        } else if constexpr (TYPE == ClientCallbackType::WRITABLE) {
+            return detail::isSet(writableHandler);
+        } else if constexpr (TYPE == ClientCallbackType::ERROR) {
+            return detail::isSet(errorHandler);
+        } else if constexpr (TYPE == ClientCallbackType::TIMEOUT) {
+            return detail::isSet(timeoutHandler);
+        } else {
+            static_assert(detail::dependentFalse<TYPE>, "Invalid ClientCallbackType");
+            std::unreachable();
+        }
+    }
+
     template <ClientCallbackType TYPE, class... Args>
     void invoke(Args&&... args) {
         log_d_("Invoking callback of type %d, client=%p", std::to_underlying(TYPE),
@@ -88,44 +157,61 @@ struct ClientCallbacks {
         }
 
         if constexpr (TYPE == ClientCallbackType::CONNECT) {
-            if (!connectHandler)
+            if (!detail::isSet(connectHandler))
                 return;
 
             std::invoke(connectHandler, connectArg, client, std::forward<Args>(args)...);
         } else if constexpr (TYPE == ClientCallbackType::DISCONNECT) {
-            if (!disconnectHandler)
+            if (!detail::isSet(disconnectHandler))
                 return;
 
             std::invoke(disconnectHandler, disconnectArg, client,
                         std::forward<Args>(args)...);
         } else if constexpr (TYPE == ClientCallbackType::POLL) {
-            if (!pollHandler)
+            if (!detail::isSet(pollHandler))
                 return;
 
             std::invoke(pollHandler, pollArg, client, std::forward<Args>(args)...);
         } else if constexpr (TYPE == ClientCallbackType::SENT) {
-            if (!sentHandler)
+            if (!detail::isSet(sentHandler))
                 return;
 
             std::invoke(sentHandler, sentArg, client, std::forward<Args>(args)...);
         } else if constexpr (TYPE == ClientCallbackType::RECV) {
-            if (!recvHandler)
+            if (!detail::isSet(recvHandler))
                 return;
 
             std::invoke(recvHandler, recvArg, client, std::forward<Args>(args)...);
+        } else if constexpr (TYPE == ClientCallbackType::RECV_BUFFER) {
+            if (!detail::isSet(bufferHandler))
+                return;
+
+            std::invoke(bufferHandler, bufferArg, client, std::forward<Args>(args)...);
+        } else if constexpr (TYPE == ClientCallbackType::AVAILABLE) {
+            if (!detail::isSet(availableHandler))
+                return;
+
+            std::invoke(availableHandler, availableArg, client,
+                        std::forward<Args>(args)...);
+        } else if constexpr (TYPE == ClientCallbackType::WRITABLE) {
+            if (!detail::isSet(writableHandler))
+                return;
+
+            std::invoke(writableHandler, writableArg, client,
+                        std::forward<Args>(args)...);
         } else if constexpr (TYPE == ClientCallbackType::ERROR) {
-            if (!errorHandler)
+            if (!detail::isSet(errorHandler))
                 return;
 
             std::invoke(errorHandler, errorArg, client, std::forward<Args>(args)...);
         } else if constexpr (TYPE == ClientCallbackType::TIMEOUT) {
-            if (!timeoutHandler)
+            if (!detail::isSet(timeoutHandler))
                 return;
 
             std::invoke(timeoutHandler, timeoutArg, client, std::forward<Args>(args)...);
 
         } else {
-            static_assert(false, "Invalid ClientCallbackType");
+            static_assert(detail::dependentFalse<TYPE>, "Invalid ClientCallbackType");
             std::unreachable();
         }
     }
@@ -144,8 +230,8 @@ struct ServerCallbacks {
 
     Server* server;
 
-    AcceptArg acceptArg;
-    AcceptHandler acceptHandler;
+    [[no_unique_address]] AcceptArg acceptArg{};
+    [[no_unique_address]] AcceptHandler acceptHandler{};
 
     ServerCallbacks(Server* s)
         : server(s) {
@@ -162,12 +248,12 @@ struct ServerCallbacks {
         }
 
         if constexpr (TYPE == ServerCallbackType::ACCEPT) {
-            if (!acceptHandler)
+            if (!detail::isSet(acceptHandler))
                 return;
 
             std::invoke(acceptHandler, acceptArg, std::forward<Args>(args)...);
         } else {
-            static_assert(false, "Invalid ServerCallbackType");
+            static_assert(detail::dependentFalse<TYPE>, "Invalid ServerCallbackType");
             std::unreachable();
         }
     }
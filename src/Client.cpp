@@ -1,5 +1,6 @@
 #include "Client.hpp"
 
+#include <array>
 #include <cstring>
 #include <type_traits>
 
@@ -40,6 +41,14 @@ constexpr Result withSockAddr(Getter&& getter, FuncIPv4&& useIpv4, FuncIPv6 useI
     return {};
 }
 
+// Connections of IPv4 clients to a dual-stack server have IPv4-mapped IPv6 addresses
+// (::ffff:a.b.c.d)
+static bool isV4Mapped(const in6_addr& addr) {
+    static constexpr std::array<std::uint8_t, 12> PREFIX = {
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xff, 0xff};
+    return std::memcmp(addr.s6_addr, PREFIX.data(), PREFIX.size()) == 0;
+}
+
 Client::Client()
     : ClientBase<Client>() {
     manage(this);
@@ -50,8 +59,31 @@ Client::Client(int socket)
     manage(this);
 }
 
+Client::Client(NonBlockingSocket socket)
+    : ClientBase<Client>(socket) {
+    manage(this);
+}
+
+ObjectPool<Client>& Client::pool() {
+    // Never destroyed, clients may outlive static destruction
+    static ObjectPool<Client>* pool =
+        new ObjectPool<Client>(CONFIG_ASYNC_TCP_CLIENT_POOL_SIZE);
+    return *pool;
+}
+
+void* Client::operator new(std::size_t size) {
+    return ::operator new(size);
+}
+
+void Client::operator delete(void* ptr) {
+    pool().deallocate(ptr);
+}
+
 Client::~Client() noexcept {
+    // Unmanage first, which waits until the worker task no longer uses the client, it may
+    // be reading the socket. Closing then notifies nobody.
     unmanage(this);
+    close();
 }
 
 IPAddress Client::remoteIP() const {
@@ -60,12 +92,17 @@ IPAddress Client::remoteIP() const {
     }
 
     return withSockAddr(
-        [&](sockaddr* addr, socklen_t size) { getpeername(_socket, addr, &size); },
+        [&](sockaddr* addr, socklen_t& size) { getpeername(_socket, addr, &size); },
         [](sockaddr_in& s) { return IPAddress(s.sin_addr.s_addr); },
         [](sockaddr_in6& s) {
+            if (isV4Mapped(s.sin6_addr)) {
+                return IPAddress(IPType::IPv4, &s.sin6_addr.s6_addr[12]);
+            }
             if (s.sin6_scope_id > 0xFF) {
-                log_w("Client::remoteIP: IPv6 scope_id %u truncated to 8 bits",
+                // The zone of IPAddress can't tell the interface
+                log_e("Client::remoteIP: IPv6 scope_id %u doesn't fit the zone",
                       s.sin6_scope_id);
+                return IPAddress();
             }
             return IPAddress(IPType::IPv6, s.sin6_addr.s6_addr,
                              static_cast<std::uint8_t>(s.sin6_scope_id));
@@ -78,7 +115,7 @@ std::uint16_t Client::remotePort() const {
     }
 
     return withSockAddr(
-        [&](sockaddr* addr, socklen_t size) { getpeername(_socket, addr, &size); },
+        [&](sockaddr* addr, socklen_t& size) { getpeername(_socket, addr, &size); },
         [](sockaddr_in& s) { return ntohs(s.sin_port); },
         [](sockaddr_in6& s) { return ntohs(s.sin6_port); });
 }
@@ -89,12 +126,17 @@ IPAddress Client::localIP() const {
     }
 
     return withSockAddr(
-        [&](sockaddr* addr, socklen_t size) { getsockname(_socket, addr, &size); },
+        [&](sockaddr* addr, socklen_t& size) { getsockname(_socket, addr, &size); },
         [](sockaddr_in& s) { return IPAddress(s.sin_addr.s_addr); },
         [](sockaddr_in6& s) {
+            if (isV4Mapped(s.sin6_addr)) {
+                return IPAddress(IPType::IPv4, &s.sin6_addr.s6_addr[12]);
+            }
             if (s.sin6_scope_id > 0xFF) {
-                log_w("Client::localIP: IPv6 scope_id %u truncated to 8 bits",
+                // The zone of IPAddress can't tell the interface
+                log_e("Client::localIP: IPv6 scope_id %u doesn't fit the zone",
                       s.sin6_scope_id);
+                return IPAddress();
             }
             return IPAddress(IPType::IPv6, s.sin6_addr.s6_addr,
                              static_cast<std::uint8_t>(s.sin6_scope_id));
@@ -107,7 +149,7 @@ std::uint16_t Client::localPort() const {
     }
 
     return withSockAddr(
-        [&](sockaddr* addr, socklen_t size) { getsockname(_socket, addr, &size); },
+        [&](sockaddr* addr, socklen_t& size) { getsockname(_socket, addr, &size); },
         [](sockaddr_in& s) { return ntohs(s.sin_port); },
         [](sockaddr_in6& s) { return ntohs(s.sin6_port); });
 }
@@ -125,6 +167,8 @@ void Client::onDisconnect(Callbacks::DisconnectHandler cb, void* arg) {
 void Client::onPoll(Callbacks::PollHandler cb, void* arg) {
     _callbacks.pollHandler = cb;
     _callbacks.pollArg = arg;
+    // Clients without a handler have no poll deadline
+    _timersChanged();
 }
 
 void Client::onAck(Callbacks::SentHandler cb, void* arg) {
@@ -132,11 +176,26 @@ void Client::onAck(Callbacks::SentHandler cb, void* arg) {
     _callbacks.sentArg = arg;
 }
 
+void Client::onWritable(Callbacks::WritableHandler cb, void* arg) {
+    _callbacks.writableHandler = cb;
+    _callbacks.writableArg = arg;
+}
+
 void Client::onData(Callbacks::RecvHandler cb, void* arg) {
     _callbacks.recvHandler = cb;
     _callbacks.recvArg = arg;
 }
 
+void Client::onBuffer(Callbacks::BufferHandler cb, void* arg) {
+    _callbacks.bufferHandler = cb;
+    _callbacks.bufferArg = arg;
+}
+
+void Client::onAvailable(Callbacks::AvailableHandler cb, void* arg) {
+    _callbacks.availableHandler = cb;
+    _callbacks.availableArg = arg;
+}
+
 void Client::onError(Callbacks::ErrorHandler cb, void* arg) {
     _callbacks.errorHandler = cb;
     _callbacks.errorArg = arg;
@@ -146,12 +205,3 @@ void Client::onTimeout(Callbacks::TimeoutHandler cb, void* arg) {
     _callbacks.timeoutHandler = cb;
     _callbacks.timeoutArg = arg;
 }
-
-std::size_t Client::ack(std::size_t len) {
-    // compatibility
-    return len;
-}
-
-void Client::ackLater() {
-    // compatibility
-}
\ No newline at end of file
@@ -1,7 +1,10 @@
 #ifndef ASYNCTCPSOCK_CLIENT_HPP
 #define ASYNCTCPSOCK_CLIENT_HPP
 
+#include <cstddef>
+
 #include "ClientBase.hpp"
+#include "ObjectPool.hpp"
 
 namespace AsyncTcpSock {
 
@@ -56,9 +59,18 @@ class Client : public ClientBase<Client> {
 
     Client();
     Client(int socket);
+    Client(NonBlockingSocket socket);
 
     ~Client() noexcept override;
 
+    /// Storage for clients accepted by servers, initially
+    /// CONFIG_ASYNC_TCP_CLIENT_POOL_SIZE clients large. Lives as long as the program.
+    static ObjectPool<Client>& pool();
+    /// Allocates on the heap, ObjectPool::create() uses the pool
+    static void* operator new(std::size_t size);
+    /// Returns pooled clients to the pool
+    static void operator delete(void* ptr);
+
     Client(const Client& other) = delete;
     Client(Client&& other) = delete;
 
@@ -74,20 +86,24 @@ class Client : public ClientBase<Client> {
     void onConnect(Callbacks::ConnectHandler cb, void* arg = nullptr);
     // disconnected
     void onDisconnect(Callbacks::DisconnectHandler cb, void* arg = nullptr);
-    // every 125ms when connected
+    // when connected and idle for the poll interval, see setPollInterval()
     void onPoll(Callbacks::PollHandler cb, void* arg = nullptr);
     // ack received
     void onAck(Callbacks::SentHandler cb, void* arg = nullptr);
+    // queued data fell to the low watermark after reaching the high one, see
+    // setWriteWatermarks()
+    void onWritable(Callbacks::WritableHandler cb, void* arg = nullptr);
     // data received
     void onData(Callbacks::RecvHandler cb, void* arg = nullptr);
+    // data received into a pooled buffer, which the handler may keep. Replaces onData.
+    void onBuffer(Callbacks::BufferHandler cb, void* arg = nullptr);
+    // data became available for read() after the receive buffer was empty, see
+    // setReceiveBuffer()
+    void onAvailable(Callbacks::AvailableHandler cb, void* arg = nullptr);
     // unsuccessful connect or error
     void onError(Callbacks::ErrorHandler cb, void* arg = nullptr);
     // ack timeout
     void onTimeout(Callbacks::TimeoutHandler cb, void* arg = nullptr);
-
-    // The following functions are just for API compatibility and do nothing
-    std::size_t ack(std::size_t len);
-    void ackLater();
 };
 
 }  // namespace AsyncTcpSock
@@ -2,17 +2,23 @@
 #define ASYNCTCPSOCK_CLIENTBASE_HPP
 
 #include <array>
+#include <atomic>
 #include <chrono>
 #include <cstdint>
+#include <functional>
+#include <mutex>
+#include <optional>
 #include <span>
 #include <utility>
 #include <vector>
 
-#include <IPAddress.h>
-#include <lwip/err.h>
-
 #include "Callbacks.hpp"
 #include "Configuration.hpp"
+#include "DnsCache.hpp"
+#include "MpscQueue.hpp"
+#include "Platform.hpp"
+#include "RecvBuffer.hpp"
+#include "RingBuffer.hpp"
 #include "SocketConnection.hpp"
 #include "WriteQueueBuffer.hpp"
 
@@ -73,47 +79,138 @@ enum class ConnectionState : std::uint8_t {
     DISCONNECTING,
 };
 
-template <class Client>
+/// Callbacks_ is a ClientCallbacks, with handlers set at runtime by default or known at
+/// compile time like those of StaticClient.
+template <class Client, class Callbacks_ = ClientCallbacks<Client>>
 class ClientBase : public SocketConnection {
   public:
-    using Callbacks = ClientCallbacks<Client>;
+    using Callbacks = Callbacks_;
 
     static constexpr int ERR_DNS_RESOLUTION_FAILED = -55;
-    static constexpr std::size_t INITIAL_WRITE_SPACE = TCP_SND_BUF;
+    static constexpr std::size_t DEFAULT_WRITE_QUEUE_LIMIT =
+        CONFIG_ASYNC_TCP_WRITE_QUEUE_LIMIT;
+    static constexpr std::size_t RECV_BUFFER_SIZE = RecvBlock::SIZE;
+    static constexpr std::size_t DEFAULT_READ_BUDGET = CONFIG_ASYNC_TCP_READ_BUDGET;
+    static constexpr std::size_t DEFAULT_ACK_WATERMARK = CONFIG_ASYNC_TCP_ACK_WATERMARK;
+    static constexpr std::chrono::milliseconds DEFAULT_POLL_INTERVAL{
+        CONFIG_ASYNC_TCP_POLL_INTERVAL};
+    static constexpr std::chrono::milliseconds DNS_TIMEOUT{CONFIG_ASYNC_TCP_DNS_TIMEOUT};
+    static constexpr std::chrono::milliseconds DEFAULT_CONNECT_TIMEOUT{
+        CONFIG_ASYNC_TCP_CONNECT_TIMEOUT};
+    static constexpr std::chrono::milliseconds CONNECT_ATTEMPT_DELAY{
+        CONFIG_ASYNC_TCP_CONNECT_ATTEMPT_DELAY};
+    static constexpr bool DEFAULT_LOCK_FREE_WRITES = CONFIG_ASYNC_TCP_LOCK_FREE_WRITES;
 
   protected:
     Callbacks _callbacks{static_cast<Client*>(this)};
 
   private:
-    // This buffer can be shared for all clients since reading is performed sequentially
-    // by the manager task.
-    static inline std::array<std::uint8_t, TCP_MSS> SHARED_READ_BUFFER{};
-
-    ConnectionState _state = ConnectionState::DISCONNECTED;
-
-    std::mutex _writeMutex{};
-    std::size_t _writeSpaceRemaining = INITIAL_WRITE_SPACE;
-    // vector is as fast as deque in my benchmarks and actually performs slightly better
-    // for smaller queue sizes
-    std::vector<WriteQueueBuffer> _writeQueue{};
-
+    // Written by the application and the manager task, which is woken up right away
+    std::atomic<ConnectionState> _state = ConnectionState::DISCONNECTED;
+
+    mutable std::mutex _writeMutex{};
+    // Bytes in the write queue that haven't been handed to the socket yet
+    std::size_t _writeQueued = 0;
+    // Also read without the lock in lock-free write mode
+    std::atomic<std::size_t> _writeQueueLimit = DEFAULT_WRITE_QUEUE_LIMIT;
+    // onWritable fires once _writeQueued drops to the low watermark after reaching the
+    // high one
+    std::size_t _writeLowWatermark = DEFAULT_WRITE_QUEUE_LIMIT / 2;
+    std::size_t _writeHighWatermark = DEFAULT_WRITE_QUEUE_LIMIT;
+    bool _writeAboveHigh = false;
+    // Finished buffers are popped from the front, which a ring does without moving the
+    // others. See benchmarks/WriteQueue.cpp for the comparison with vector and deque.
+    RingBuffer<WriteQueueBuffer> _writeQueue{};
+    // Whether the manager watches the socket for readability and writability. Only
+    // changed with _writeMutex locked so that the notifications to the manager can't be
+    // reordered.
+    bool _readInterest = true;
+    bool _writeInterest = false;
+
+    // Lock-free write mode, see setLockFreeWrites(). Writes are submitted to _submitted
+    // and moved to the write queue by the manager task, with _writeMutex locked.
+    struct SubmittedWrite : MpscNode {
+        WriteQueueBuffer buffer;
+        std::size_t size;
+    };
+    // Fixed while the socket is open, but read without a lock
+    std::atomic<bool> _lockFreeWrites = DEFAULT_LOCK_FREE_WRITES;
+    MpscQueue<SubmittedWrite> _submitted{};
+    // Whether the manager has been signaled and not yet taken the submissions
+    std::atomic<bool> _submitPending = false;
+    // Bytes submitted and not yet handed to the socket
+    std::atomic<std::size_t> _submitUnwritten = 0;
+    // A submission was refused or truncated, which arms onWritable
+    std::atomic<bool> _submitRefused = false;
+
+    // Received data waiting for read() in pull mode, see setReceiveBuffer(). Reading
+    // pauses while it is full.
+    mutable std::mutex _recvMutex{};
+    ByteRing _recvRing{};
+    bool _recvPaused = false;
+    // Data delivered to onData or onBuffer whose acknowledgement was deferred with
+    // ackLater(). Reading pauses while there is more of it than the watermark.
+    std::size_t _unackedBytes = 0;
+    std::size_t _ackWatermark = DEFAULT_ACK_WATERMARK;
+    bool _ackLaterRequested = false;
+    bool _ackPaused = false;
+    // Reading paused by the application, see setReadPaused()
+    bool _readPaused = false;
+
+    // Set by connect() and read by the manager task, both with _writeMutex locked
     IPAddress _ip{};
     std::uint16_t _port{};
 
+    // Connecting races the addresses of a host name (RFC 8305): while the attempts so
+    // far are pending, the next address is tried every CONNECT_ATTEMPT_DELAY or as soon
+    // as one fails. _socket is one of the attempts, the first to connect takes its
+    // place. All of this is guarded by _writeMutex.
+    struct ConnectAttempt {
+        int socket;
+        IPAddress ip;
+    };
+    DnsAddresses _addresses{};
+    std::size_t _nextAddress = 0;
+    std::vector<ConnectAttempt> _attempts{};
+    std::chrono::steady_clock::time_point _nextAttempt{};
+    std::chrono::steady_clock::time_point _connectDeadline{};
+    std::optional<std::chrono::steady_clock::duration> _connectTimeout =
+        DEFAULT_CONNECT_TIMEOUT > std::chrono::milliseconds::zero()
+            ? std::optional<std::chrono::steady_clock::duration>(DEFAULT_CONNECT_TIMEOUT)
+            : std::nullopt;
+
+    // The timeouts and the poll interval are set by the application and read by the
+    // manager task, both with _writeMutex locked
     std::optional<std::chrono::steady_clock::duration> _ack_timeout =
         std::chrono::milliseconds(CONFIG_ASYNC_TCP_MAX_ACK_TIME);
     std::optional<std::chrono::steady_clock::duration> _rx_timeout = std::nullopt;
     std::chrono::steady_clock::time_point _rx_last_packet{};
     bool _ack_timeout_signaled = false;
+    // onPoll fires once the client has been idle for the interval
+    std::optional<std::chrono::steady_clock::duration> _pollInterval =
+        DEFAULT_POLL_INTERVAL;
+    std::chrono::steady_clock::time_point _lastPoll{};
+    std::chrono::steady_clock::time_point _dnsDeadline{};
+
+    std::size_t _readBudget = DEFAULT_READ_BUDGET;
+
+    // Run by the manager task once the callbacks have returned, see releaseLater().
+    // Guarded by _writeMutex.
+    std::function<void()> _release{};
+    // Held while the socket is closed, so that reusable() on another thread can't peek
+    // it in the meantime or peek a new socket that took over the descriptor
+    mutable std::mutex _closeMutex{};
 
   public:
-    static void dnsFoundCallback(const char* name, const ip_addr_t* ip, void* arg);
+    static void dnsFoundCallback(const DnsAddresses* addresses, void* arg);
 
     /// Create a client in an unconnected state.
     ClientBase();
     /// Create a client from an existing connected socket, for example from ::accept() in
     /// a server.
     ClientBase(int socket);
+    /// Same as above, saving the fcntl() calls for a socket that is non-blocking already.
+    ClientBase(NonBlockingSocket socket);
 
     ClientBase(const ClientBase& other) = delete;
     ClientBase(ClientBase&& other) = delete;
@@ -123,7 +220,11 @@ class ClientBase : public SocketConnection {
 
     ~ClientBase() noexcept override;
 
+    /// Connect to an IPv4 or IPv6 address. The connection is established by the manager
+    /// task, onConnect or onError tell how it went.
     virtual bool connect(IPAddress ip, std::uint16_t port);
+    /// Connect to the addresses the host name resolves to, racing them as described by
+    /// RFC 8305 (Happy Eyeballs). The first connection established is kept.
     virtual bool connect(const char* host, std::uint16_t port);
 
     void close(bool now = false);
@@ -131,8 +232,24 @@ class ClientBase : public SocketConnection {
 
     bool freeable() const;
     bool connected() const;
+    // compatibility, returns the closest LWIP tcp_state (CLOSED, SYN_SENT, ESTABLISHED)
+    std::uint8_t state() const;
     bool canSend() const;
+    /// Bytes that add() takes right now: the free space of the socket's send buffer plus
+    /// the write queue limit, minus what is queued. Only the write queue limit with
+    /// lock-free writes.
     std::size_t space() const;
+    /// Bytes queued at most on top of what the socket's send buffer takes
+    void setWriteQueueLimit(std::size_t limit);
+    /// onWritable is invoked once the queued bytes fall to low after reaching high, or
+    /// after add() took less than it was given.
+    void setWriteWatermarks(std::size_t low, std::size_t high);
+    /// In lock-free write mode, add() pushes the data to a queue that only the manager
+    /// task takes from and writes to the socket, so that threads writing to the same
+    /// client don't wait for each other or for the socket. The write queue limit is
+    /// enforced approximately, and send() does nothing. Call before connecting, returns
+    /// false without a change while the connection is open.
+    bool setLockFreeWrites(bool enabled);
 
     /// Add the buffer to the send queue. It will be sent by the manager task as soon as
     /// possible.
@@ -150,20 +267,67 @@ class ClientBase : public SocketConnection {
     /// calling thread if you do so.
     bool send();
 
-    /// Adds data to the send queue and immediately attempts to send it if the queue
-    /// wasn't full.
+    /// Writes data straight to the socket if nothing is queued, and adds what the socket
+    /// doesn't take to the send queue. With queued data, adds it to the send queue and
+    /// immediately attempts to send it if the IMMEDIATE flag is set.
     std::size_t write(const char* str,
                       std::size_t size = 0,
                       ClientApiFlags apiFlags = ClientApiFlag::COPY);
     std::size_t write(const std::uint8_t* bytes,
                       std::size_t size,
                       ClientApiFlags apiFlags = ClientApiFlag::COPY);
+    /// Switch to pull mode: received data is kept in a ring of the given capacity until
+    /// it is read(), and onAvailable is invoked whenever the ring stops being empty. The
+    /// socket isn't read while the ring is full. A capacity of 0 returns to onData. Only
+    /// possible while no data is buffered, call it before connecting or from onConnect.
+    bool setReceiveBuffer(std::size_t capacity);
+    /// Bytes that can be read() in pull mode
+    std::size_t available() const;
+    /// Copy buffered bytes without consuming them. Returns the number of bytes copied.
+    std::size_t peek(std::span<std::uint8_t> out) const;
+    /// Move buffered bytes into the given memory. Returns the number of bytes read.
+    std::size_t read(std::span<std::uint8_t> out);
+    std::size_t read(std::uint8_t* data, std::size_t size);
+
+    /// Call from onData or onBuffer to acknowledge that data later with ack(). Reading
+    /// pauses, so that the receive window closes, while more data than the watermark is
+    /// unacknowledged.
+    void ackLater();
+    /// Acknowledge data deferred with ackLater(), possibly from another thread. Returns
+    /// the number of bytes acknowledged.
+    std::size_t ack(std::size_t len);
+    /// Unacknowledged bytes allowed before reading pauses, 0 pauses on any
+    void setAckWatermark(std::size_t watermark);
+    /// Stop reading until resumed, for example while an idle connection waits to be
+    /// reused. What the peer sends, a FIN included, stays in the socket meanwhile, unless
+    /// the connection fails. Connecting resumes reading.
+    void setReadPaused(bool paused);
+    /// Whether the connection can carry another request: still connected, with nothing
+    /// received and unread, neither in the receive buffer nor in the socket. Only
+    /// conclusive while reading is paused. Safe on any thread, the manager task may close
+    /// the connection meanwhile.
+    bool reusable() const;
+    /// Run release on the manager task once no callback of the client is running, so
+    /// that it may clear the handlers or delete the client. Right away if the client
+    /// isn't managed. A later call replaces a pending release.
+    void releaseLater(std::function<void()> release);
+
     // If true, disables Nagle's algorithm (TCP_NODELAY)
     void setNoDelay(bool nodelay);
     bool getNoDelay();
 
+    // Bytes read at most per readiness event, at least one buffer
+    void setReadBudget(std::size_t budget);
+
     void setAckTimeout(std::optional<std::chrono::steady_clock::duration> timeout);
     void setRxTimeout(std::optional<std::chrono::steady_clock::duration> timeout);
+    /// How long connect() may take until the connection is established, after which
+    /// onError(ERR_TIMEOUT) fires. std::nullopt waits for as long as the kernel tries.
+    /// Applies from the next connect().
+    void setConnectTimeout(std::optional<std::chrono::steady_clock::duration> timeout);
+    /// How long the client must be idle before onPoll fires, std::nullopt for never.
+    /// Clients without a deadline cost the manager nothing while idle.
+    void setPollInterval(std::optional<std::chrono::steady_clock::duration> interval);
 
     // compatibility
     template <class Integer>
@@ -197,22 +361,90 @@ class ClientBase : public SocketConnection {
     // Invokes the error callback and closes the socket - does not delete
     void _error(int errorCode);
 
+    // Starts connecting to _addresses. Returns 0, or the error of the last address if
+    // none could be tried.
+    int _startConnect(std::uint16_t port);
+    // Settles the race once a connecting socket became writable. Returns std::nullopt
+    // while attempts are pending, then 0 or the error of the last attempt.
+    std::optional<int> _finishConnect();
+    // The following assume that _writeMutex is locked.
+    // Closes the sockets racing _socket
+    void _closeAttempts();
+    // Opens a socket connecting to the next address that takes one, -1 once there is
+    // none left. error receives the reason addresses were skipped.
+    int _openAttempt(IPAddress& ip, int& error);
+    // Races the next address alongside _socket. Returns whether there was one.
+    bool _addAttempt(std::chrono::steady_clock::time_point now);
+    // Makes socket the client's socket and closes previous. Fails if the client has been
+    // closed in the meantime.
+    bool _replaceSocket(int previous, int socket);
+    void _discardSocket(int socket);
+
     virtual bool _processWriteQueue(std::unique_lock<std::mutex>& writeQueueLock);
     void _cleanupWriteQueue(std::unique_lock<std::mutex>& writeQueueLock);
+    // Copies data into the chunk at the end of the write queue, and new ones once it is
+    // full. Assumes that _writeMutex is locked.
+    void _appendToChunks(std::span<const std::uint8_t> data,
+                         std::chrono::steady_clock::time_point now);
+    static WriteQueueBuffer _makeBuffer(std::span<const std::uint8_t> data,
+                                        ClientApiFlags apiFlags,
+                                        std::chrono::steady_clock::time_point now);
+    // Appends data that fit into the queue, assumes that _writeMutex is locked. buf holds
+    // the data unless it is coalesced into chunks.
+    void _enqueue(WriteQueueBuffer&& buf,
+                  std::span<const std::uint8_t> data,
+                  bool coalesce,
+                  std::chrono::steady_clock::time_point now);
+    // The fast path of write(): one write to the socket while the queue is empty, the
+    // rest is queued. Returns the number of bytes taken, or std::nullopt if the data
+    // must go through add().
+    virtual std::optional<std::size_t> _writeDirect(const std::uint8_t* data,
+                                                    std::size_t size,
+                                                    ClientApiFlags apiFlags);
     void _clearWriteQueue();
+    // add() in lock-free write mode
+    std::size_t _submit(const std::uint8_t* data,
+                        std::size_t size,
+                        ClientApiFlags apiFlags);
+    // Moves submitted writes to the write queue, assumes that _writeMutex is locked.
+    // Returns the number of bytes taken.
+    std::size_t _takeSubmitted();
+    // Both assume that _writeMutex is locked
+    void _setReadInterest(bool readInterest);
+    void _setWriteInterest(bool writeInterest);
+    // Applies the reasons to pause reading, assumes that _recvMutex is locked
+    void _updateReadInterest();
+    // Counts delivered data if its acknowledgement was deferred. Returns whether reading
+    // is paused.
+    bool _deferAck(std::size_t size);
+    // For readiness while the socket isn't read, which pollers report for errors and
+    // hangups regardless of the interest. Leaves any data in the socket.
+    void _checkHangup();
+    // Free space of the receive ring in pull mode, pauses reading if there is none
+    std::span<std::uint8_t> _receiveSpace();
+    // Append data read into _receiveSpace(), notifying the application if it was empty
+    void _receiveCommit(std::size_t size);
+
+    // Assumes that _writeMutex is locked. Asking the socket costs system calls, so it is
+    // optional.
+    std::size_t _writeSpace(bool includeSocket) const;
 
     bool _checkAckTimeout();
+    // Without a system call, based on what the manager read
     bool _checkRxTimeout();
+    // Tell the manager that _nextDeadline() may have moved earlier
+    void _timersChanged();
 
   public:
     // Required by ManagedClient concept
-    bool _pendingWrite();
-
     bool _sockIsWriteable();
-    void _sockIsReadable();
+    void _sockIsReadable(std::span<std::uint8_t> scratch);
 
     void _sockDelayedConnect();
+    std::chrono::steady_clock::time_point _nextDeadline() const;
     void _sockPoll();
+    void _sockSubmitted();
+    void _sockReleased();
     void _processingDone();
 };
 
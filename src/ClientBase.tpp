@@ -5,48 +5,41 @@
 
 //
 
+#include <algorithm>
 #include <cerrno>
 #include <chrono>
 #include <cstring>
+#include <memory>
 #include <utility>
 
-#include <esp32-hal-log.h>
-#include <lwip/dns.h>
-#include <lwip/ip_addr.h>
-#include <lwip/sockets.h>
-
 #include "Callbacks.hpp"
+#include "Platform.hpp"
 #include "WriteQueueBuffer.hpp"
 
-#ifdef EINPROGRESS
-#if EINPROGRESS != 119
-#error EINPROGRESS invalid
-#endif
-#endif
-
 namespace AsyncTcpSock {
 
 // This function runs in the LWIP thread
-template <class Client>
-void ClientBase<Client>::dnsFoundCallback(const char* _, const ip_addr_t* ip, void* arg) {
+template <class Client, class Callbacks_>
+void ClientBase<Client, Callbacks_>::dnsFoundCallback(const DnsAddresses* addresses,
+                                                      void* arg) {
     ClientBase* c = static_cast<ClientBase*>(arg);
 
-    if (ip) {
-        c->_ip.from_ip_addr_t(ip);
-    } else {
-        c->_ip = IPAddress();
+    {
+        std::lock_guard lock(c->_writeMutex);
+        c->_addresses = addresses != nullptr ? *addresses : DnsAddresses();
     }
 
     c->setDnsFinished(true);
+    signalDnsFinished(static_cast<Client*>(c));
 }
 
-template <class Client>
-ClientBase<Client>::ClientBase()
+template <class Client, class Callbacks_>
+ClientBase<Client, Callbacks_>::ClientBase()
     : SocketConnection() {
 }
 
-template <class Client>
-ClientBase<Client>::ClientBase(int socket)
+template <class Client, class Callbacks_>
+ClientBase<Client, Callbacks_>::ClientBase(int socket)
     : SocketConnection(socket) {
     if (_socket > 0) {
         _state = ConnectionState::CONNECTED;
@@ -54,89 +47,103 @@ ClientBase<Client>::ClientBase(int socket)
     }
 }
 
-template <class Client>
-ClientBase<Client>::~ClientBase() noexcept {
-    close();
+template <class Client, class Callbacks_>
+ClientBase<Client, Callbacks_>::ClientBase(NonBlockingSocket socket)
+    : SocketConnection(socket) {
+    if (_socket > 0) {
+        _state = ConnectionState::CONNECTED;
+        _rx_last_packet = std::chrono::steady_clock::now();
+    }
 }
 
-template <class Client>
-bool ClientBase<Client>::connect(IPAddress ip, std::uint16_t port) {
-    if (isOpen()) {
-        log_w("already connected, state %d", std::to_underlying(_state));
-        return false;
+template <class Client, class Callbacks_>
+ClientBase<Client, Callbacks_>::~ClientBase() noexcept {
+    if (_state == ConnectionState::WAITING_FOR_DNS) {
+        DnsCache::instance().cancel(this);
     }
+    close();
 
-    int socket = ::socket(AF_INET, SOCK_STREAM, 0);
-    if (socket < 0) {
-        log_e("socket() error: %d", errno);
+    // Submissions that raced with closing
+    while (SubmittedWrite* write = _submitted.pop()) {
+        delete write;
+    }
+}
+
+template <class Client, class Callbacks_>
+bool ClientBase<Client, Callbacks_>::connect(IPAddress ip, std::uint16_t port) {
+    if (isOpen() || _state == ConnectionState::WAITING_FOR_DNS) {
+        log_w("already connected, state %d", std::to_underlying(_state.load()));
         return false;
     }
 
-    sockaddr serveraddr = std::bit_cast<sockaddr>(
-        sockaddr_in{.sin_len = sizeof(sockaddr_in),
-                    .sin_family = AF_INET,
-                    .sin_port = htons(port),
-                    .sin_addr = {.s_addr = static_cast<std::uint32_t>(ip)},
-                    .sin_zero = {}});
+    {
+        std::lock_guard lock(_writeMutex);
+        _addresses = DnsAddresses(std::span(&ip, 1));
+    }
 
-    log_d_("connecting to %s:%d on socket %d", ip.toString().c_str(), port, socket);
+    return _startConnect(port) == 0;
+}
 
-    errno = 0;
-    int result = ::connect(socket, &serveraddr, sizeof(sockaddr_in));
-    if (result < 0 && errno != EINPROGRESS) {
-        log_e("connect to %s:%d on socket %d failed, errno: %d (%s)",
-              ip.toString().c_str(), port, socket, errno, strerror(errno));
-        ::close(socket);
+template <class Client, class Callbacks_>
+bool ClientBase<Client, Callbacks_>::connect(const char* host, std::uint16_t port) {
+    if (isOpen()) {
+        log_w("already connected, state %d", std::to_underlying(_state.load()));
         return false;
     }
 
-    _ip = ip;
-    _port = port;
-    _state = ConnectionState::CONNECTING;
-
-    // Updating state visible to asyncTcpSock task
-    _configureSocket(socket);
-
-    // Socket is now connecting. Should become writable in asyncTcpSock task, which then
-    // updates the state in _sockIsWritable().
-    log_i("successfully connected to %s:%d on socket %d", ip.toString().c_str(), port,
-          socket);
-    return true;
-}
+    // A second lookup would call back twice and start two connects
+    ConnectionState previous = _state.load();
+    do {
+        if (previous == ConnectionState::WAITING_FOR_DNS) {
+            log_w("already waiting for the lookup of a host name");
+            return false;
+        }
+    } while (!_state.compare_exchange_weak(previous, ConnectionState::WAITING_FOR_DNS));
 
-template <class Client>
-bool ClientBase<Client>::connect(const char* host, std::uint16_t port) {
     log_d_("connect to %s port %d using DNS...", host, port);
 
-    ip_addr_t addr;
-    err_t err = dns_gethostbyname(host, &addr, &dnsFoundCallback, this);
+    {
+        // The lookup may finish on another thread before resolve() returns
+        std::lock_guard lock(_writeMutex);
+        _port = port;
+        _dnsDeadline = std::chrono::steady_clock::now() + DNS_TIMEOUT;
+    }
 
-    if (err == ERR_OK) {
-        IPAddress resolved(&addr);
-        log_d_("\taddr resolved as %s, connecting...", resolved.toString().c_str());
+    DnsAddresses resolved;
+    const Platform::DnsStatus status =
+        DnsCache::instance().resolve(host, resolved, &ClientBase::dnsFoundCallback, this);
+
+    if (status == Platform::DnsStatus::RESOLVED) {
+        log_d_("\taddr resolved as %s, connecting...",
+               resolved.addresses[0].toString().c_str());
+        _state = previous;
+        {
+            std::lock_guard lock(_writeMutex);
+            _addresses = resolved;
+        }
 
-        return connect(std::move(resolved), port);
+        return _startConnect(port) == 0;
 
-    } else if (err == ERR_INPROGRESS) {
+    } else if (status == Platform::DnsStatus::IN_PROGRESS) {
         log_d_("\twaiting for DNS resolution");
-        _state = ConnectionState::WAITING_FOR_DNS;
-        _port = port;
+        _timersChanged();
 
         return true;
     }
 
-    log_e("error: %d", err);
+    _state = previous;
+    log_e("DNS resolution of %s failed", host);
     return false;
 }
 
-template <class Client>
-void ClientBase<Client>::close(bool _) {
+template <class Client, class Callbacks_>
+void ClientBase<Client, Callbacks_>::close([[maybe_unused]] bool now) {
     if (isOpen())
         _close();
 }
 
-template <class Client>
-err_enum_t ClientBase<Client>::abort() {
+template <class Client, class Callbacks_>
+err_enum_t ClientBase<Client, Callbacks_>::abort() {
     if (isOpen()) {
         // Note: needs LWIP_SO_LINGER to be enabled in order to work, otherwise
         // this call is equivalent to close().
@@ -149,8 +156,8 @@ err_enum_t ClientBase<Client>::abort() {
     return ERR_ABRT;
 }
 
-template <class Client>
-bool ClientBase<Client>::freeable() const {
+template <class Client, class Callbacks_>
+bool ClientBase<Client, Callbacks_>::freeable() const {
     if (!isOpen()) {
         return true;
     }
@@ -158,72 +165,133 @@ bool ClientBase<Client>::freeable() const {
     return _state == ConnectionState::DISCONNECTED;
 }
 
-template <class Client>
-bool ClientBase<Client>::connected() const {
+template <class Client, class Callbacks_>
+bool ClientBase<Client, Callbacks_>::connected() const {
     return _state == ConnectionState::CONNECTED;
 }
 
-template <class Client>
-bool ClientBase<Client>::canSend() const {
+template <class Client, class Callbacks_>
+std::uint8_t ClientBase<Client, Callbacks_>::state() const {
+    switch (_state.load()) {
+        case ConnectionState::CONNECTING:
+            return 2;
+        case ConnectionState::CONNECTED:
+            return 4;
+        default:
+            return 0;
+    }
+}
+
+template <class Client, class Callbacks_>
+bool ClientBase<Client, Callbacks_>::canSend() const {
     return space() > 0;
 }
 
-template <class Client>
-std::size_t ClientBase<Client>::space() const {
+template <class Client, class Callbacks_>
+std::size_t ClientBase<Client, Callbacks_>::space() const {
     if (!connected())
         return 0;
 
-    return _writeSpaceRemaining;
+    if (_lockFreeWrites) {
+        const std::size_t limit = _writeQueueLimit.load(std::memory_order_relaxed);
+        const std::size_t unwritten = _submitUnwritten.load(std::memory_order_relaxed);
+        return limit > unwritten ? limit - unwritten : 0;
+    }
+
+    std::lock_guard lock(_writeMutex);
+    return _writeSpace(true);
+}
+
+template <class Client, class Callbacks_>
+void ClientBase<Client, Callbacks_>::setWriteQueueLimit(std::size_t limit) {
+    std::lock_guard lock(_writeMutex);
+    _writeQueueLimit = limit;
+}
+
+template <class Client, class Callbacks_>
+void ClientBase<Client, Callbacks_>::setWriteWatermarks(std::size_t low,
+                                                        std::size_t high) {
+    std::lock_guard lock(_writeMutex);
+    _writeHighWatermark = high;
+    _writeLowWatermark = std::min(low, high);
 }
 
-template <class Client>
-std::size_t ClientBase<Client>::add(std::span<const std::uint8_t> data,
-                                    ClientApiFlags apiflags) {
+template <class Client, class Callbacks_>
+bool ClientBase<Client, Callbacks_>::setLockFreeWrites(bool enabled) {
+    std::lock_guard lock(_writeMutex);
+    if (isOpen() && enabled != _lockFreeWrites) {
+        // Writes already queued in one mode would race with those of the other
+        log_w("can't change the write mode of an open connection");
+        return false;
+    }
+
+    _lockFreeWrites = enabled;
+    return true;
+}
+
+template <class Client, class Callbacks_>
+std::size_t ClientBase<Client, Callbacks_>::add(std::span<const std::uint8_t> data,
+                                                ClientApiFlags apiflags) {
     return add(data.data(), data.size(), apiflags);
 }
 
-template <class Client>
-std::size_t ClientBase<Client>::add(const std::uint8_t* data,
-                                    std::size_t size,
-                                    ClientApiFlags apiFlags) {
+template <class Client, class Callbacks_>
+std::size_t ClientBase<Client, Callbacks_>::add(const std::uint8_t* data,
+                                                std::size_t size,
+                                                ClientApiFlags apiFlags) {
     if (!connected() || data == nullptr || size == 0)
         return 0;
 
-    const std::size_t remainingSpace = space();
-    if (remainingSpace == 0)
+    if (_lockFreeWrites) {
+        return _submit(data, size, apiFlags);
+    }
+
+    std::size_t remainingSpace;
+    {
+        // Queued data goes to the socket first, its free space only matters if the queue
+        // limit alone doesn't suffice
+        std::lock_guard lock(_writeMutex);
+        remainingSpace = _writeSpace(false);
+        if (remainingSpace < size) {
+            remainingSpace = _writeSpace(true);
+        }
+    }
+    if (remainingSpace == 0) {
+        std::lock_guard lock(_writeMutex);
+        _writeAboveHigh = true;
         return 0;
+    }
 
     const std::size_t toSend = std::min(remainingSpace, size);
+    const auto now = std::chrono::steady_clock::now();
+    // Small copies are appended to pooled chunks, so that many of them end up in one
+    // buffer and one write
+    const bool coalesce =
+        apiFlags.test(ClientApiFlag::COPY) && toSend <= WriteChunk::SIZE;
+
     WriteQueueBuffer buf;
-    if (apiFlags.test(ClientApiFlag::COPY)) {
-        buf.emplace<OwnedWriteQueueBuffer>(OwnedWriteQueueBuffer{
-            {.queuedAt = std::chrono::steady_clock::now()},
-            std::vector<std::uint8_t>(data, data + toSend),
-        });
-    } else {
-        buf.emplace<BorrowedWriteQueueBuffer>(BorrowedWriteQueueBuffer{
-            {.queuedAt = std::chrono::steady_clock::now()},
-            std::span<const std::uint8_t>(data, toSend),
-        });
+    if (!coalesce) {
+        // Allocated before taking the lock, chunks are appended to with it held
+        buf = _makeBuffer(std::span(data, toSend), apiFlags, now);
     }
 
     {
         std::lock_guard lock(_writeMutex);
-        _writeQueue.push_back(std::move(buf));
-        _writeSpaceRemaining -= toSend;
-        _ack_timeout_signaled = false;
+        _enqueue(std::move(buf), std::span(data, toSend), coalesce, now);
+        if (toSend < size) {
+            _writeAboveHigh = true;
+        }
     }
 
-    log_d_("Queued %zu bytes for sending, %zu bytes remaining space, socket %d", toSend,
-           space(), _socket.load());
+    log_d_("Queued %zu bytes for sending, socket %d", toSend, _socket.load());
 
     return toSend;
 }
 
-template <class Client>
-std::size_t ClientBase<Client>::add(const char* str,
-                                    std::size_t size,
-                                    ClientApiFlags apiFlags) {
+template <class Client, class Callbacks_>
+std::size_t ClientBase<Client, Callbacks_>::add(const char* str,
+                                                std::size_t size,
+                                                ClientApiFlags apiFlags) {
     if (str == nullptr)
         return 0;
 
@@ -234,23 +302,23 @@ std::size_t ClientBase<Client>::add(const char* str,
     return add(reinterpret_cast<const std::uint8_t*>(str), size, apiFlags);
 }
 
-template <class Client>
-bool ClientBase<Client>::send() {
+template <class Client, class Callbacks_>
+bool ClientBase<Client, Callbacks_>::send() {
     if (!connected())
         return false;
 
-    log_d_("socket %d", _socket.load());
+    if (_lockFreeWrites) {
+        // Only the manager task writes to the socket
+        return true;
+    }
 
-    fd_set sockSet_w{};
-    FD_ZERO(&sockSet_w);
-    FD_SET(_socket, &sockSet_w);
-    timeval tv{.tv_sec = 0, .tv_usec = 0};
+    log_d_("socket %d", _socket.load());
 
-    int ready = select(_socket + 1, nullptr, &sockSet_w, nullptr, &tv);
-    if (ready > 0) {
+    if (Platform::socketWritable(_socket)) {
         // Basically does the same as _sockIsWriteable() but avoids sending notifications
         // to prevent callers from deadlocking when the SENT callback is invoked.
-        // The SENT callback is then invoked later in _sockPoll
+        // The SENT callback is then invoked later in _sockIsWriteable(), the write
+        // interest stays set until the queue is cleaned up.
         std::unique_lock lock(_writeMutex);
         if (!_writeQueue.empty()) {
             return _processWriteQueue(lock);
@@ -260,10 +328,10 @@ bool ClientBase<Client>::send() {
     return false;
 }
 
-template <class Client>
-std::size_t ClientBase<Client>::write(const char* str,
-                                      std::size_t size,
-                                      ClientApiFlags apiFlags) {
+template <class Client, class Callbacks_>
+std::size_t ClientBase<Client, Callbacks_>::write(const char* str,
+                                                  std::size_t size,
+                                                  ClientApiFlags apiFlags) {
     if (str == nullptr)
         return 0;
 
@@ -274,12 +342,18 @@ std::size_t ClientBase<Client>::write(const char* str,
     return write(reinterpret_cast<const std::uint8_t*>(str), size, apiFlags);
 }
 
-template <class Client>
-std::size_t ClientBase<Client>::write(const std::uint8_t* bytes,
-                                      std::size_t size,
-                                      ClientApiFlags apiFlags) {
-    log_i("Writing %zu/%zu bytes to socket %d", size, _writeSpaceRemaining,
-          _socket.load());
+template <class Client, class Callbacks_>
+std::size_t ClientBase<Client, Callbacks_>::write(const std::uint8_t* bytes,
+                                                  std::size_t size,
+                                                  ClientApiFlags apiFlags) {
+    log_i("Writing %zu bytes to socket %d", size, _socket.load());
+
+    if (connected() && bytes != nullptr && size > 0) {
+        const std::optional<std::size_t> taken = _writeDirect(bytes, size, apiFlags);
+        if (taken) {
+            return *taken;
+        }
+    }
 
     std::size_t toSend = add(bytes, size, apiFlags);
 
@@ -299,8 +373,8 @@ std::size_t ClientBase<Client>::write(const std::uint8_t* bytes,
     return toSend;
 }
 
-template <class Client>
-void ClientBase<Client>::setNoDelay(bool nodelay) {
+template <class Client, class Callbacks_>
+void ClientBase<Client, Callbacks_>::setNoDelay(bool nodelay) {
     if (!isOpen())
         return;
 
@@ -312,8 +386,8 @@ void ClientBase<Client>::setNoDelay(bool nodelay) {
     }
 }
 
-template <class Client>
-bool ClientBase<Client>::getNoDelay() {
+template <class Client, class Callbacks_>
+bool ClientBase<Client, Callbacks_>::getNoDelay() {
     if (!isOpen())
         // Nagle's algorithm is enabled by default
         return false;
@@ -329,30 +403,197 @@ bool ClientBase<Client>::getNoDelay() {
     return static_cast<bool>(nodelay);
 }
 
-template <class Client>
-void ClientBase<Client>::setAckTimeout(
+template <class Client, class Callbacks_>
+bool ClientBase<Client, Callbacks_>::setReceiveBuffer(std::size_t capacity) {
+    std::lock_guard lock(_recvMutex);
+    if (!_recvRing.empty()) {
+        log_e("Can't change the receive buffer with %zu bytes buffered",
+              _recvRing.size());
+        return false;
+    }
+
+    _recvRing = capacity > 0 ? ByteRing(capacity) : ByteRing();
+    if (_recvPaused) {
+        _recvPaused = false;
+        _updateReadInterest();
+    }
+    return true;
+}
+
+template <class Client, class Callbacks_>
+std::size_t ClientBase<Client, Callbacks_>::available() const {
+    std::lock_guard lock(_recvMutex);
+    return _recvRing.size();
+}
+
+template <class Client, class Callbacks_>
+std::size_t ClientBase<Client, Callbacks_>::peek(std::span<std::uint8_t> out) const {
+    std::lock_guard lock(_recvMutex);
+    return _recvRing.peek(out);
+}
+
+template <class Client, class Callbacks_>
+std::size_t ClientBase<Client, Callbacks_>::read(std::span<std::uint8_t> out) {
+    std::lock_guard lock(_recvMutex);
+    const std::size_t size = _recvRing.read(out);
+
+    if (size > 0 && _recvPaused) {
+        _recvPaused = false;
+        _updateReadInterest();
+    }
+
+    return size;
+}
+
+template <class Client, class Callbacks_>
+std::size_t ClientBase<Client, Callbacks_>::read(std::uint8_t* data, std::size_t size) {
+    return read(std::span(data, size));
+}
+
+template <class Client, class Callbacks_>
+std::size_t ClientBase<Client, Callbacks_>::ack(std::size_t len) {
+    std::lock_guard lock(_recvMutex);
+    const std::size_t acked = std::min(len, _unackedBytes);
+    _unackedBytes -= acked;
+
+    if (_ackPaused && _unackedBytes <= _ackWatermark) {
+        _ackPaused = false;
+        _updateReadInterest();
+    }
+
+    return acked;
+}
+
+template <class Client, class Callbacks_>
+void ClientBase<Client, Callbacks_>::ackLater() {
+    std::lock_guard lock(_recvMutex);
+    _ackLaterRequested = true;
+}
+
+template <class Client, class Callbacks_>
+void ClientBase<Client, Callbacks_>::setAckWatermark(std::size_t watermark) {
+    std::lock_guard lock(_recvMutex);
+    _ackWatermark = watermark;
+
+    const bool paused = _unackedBytes > _ackWatermark;
+    if (paused != _ackPaused) {
+        _ackPaused = paused;
+        _updateReadInterest();
+    }
+}
+
+template <class Client, class Callbacks_>
+void ClientBase<Client, Callbacks_>::setReadPaused(bool paused) {
+    std::lock_guard lock(_recvMutex);
+    if (paused != _readPaused) {
+        _readPaused = paused;
+        _updateReadInterest();
+    }
+}
+
+template <class Client, class Callbacks_>
+bool ClientBase<Client, Callbacks_>::reusable() const {
+    if (!connected()) {
+        return false;
+    }
+
+    {
+        std::lock_guard lock(_recvMutex);
+        if (!_recvRing.empty()) {
+            return false;
+        }
+    }
+
+    // A FIN, a reset or data nobody asked for would be waiting in the socket
+    std::lock_guard lock(_closeMutex);
+    const int socket = _socket.load();
+    if (socket < 0) {
+        return false;
+    }
+    std::uint8_t byte;
+    errno = 0;
+    const ssize_t result = Platform::socketPeek(socket, &byte, sizeof(byte));
+    return result < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+}
+
+template <class Client, class Callbacks_>
+void ClientBase<Client, Callbacks_>::releaseLater(std::function<void()> release) {
+    if (!getHandle().isValid()) {
+        // No manager task runs callbacks of the client
+        release();
+        return;
+    }
+
+    {
+        std::lock_guard lock(_writeMutex);
+        _release = std::move(release);
+    }
+    signalReleased(static_cast<Client*>(this));
+}
+
+template <class Client, class Callbacks_>
+void ClientBase<Client, Callbacks_>::setReadBudget(std::size_t budget) {
+    _readBudget = std::max(budget, RECV_BUFFER_SIZE);
+}
+
+template <class Client, class Callbacks_>
+void ClientBase<Client, Callbacks_>::setAckTimeout(
+    std::optional<std::chrono::steady_clock::duration> timeout) {
+    {
+        std::lock_guard lock(_writeMutex);
+        _ack_timeout = timeout;
+    }
+    _timersChanged();
+}
+
+template <class Client, class Callbacks_>
+void ClientBase<Client, Callbacks_>::setRxTimeout(
     std::optional<std::chrono::steady_clock::duration> timeout) {
-    _ack_timeout = timeout;
+    {
+        std::lock_guard lock(_writeMutex);
+        _rx_timeout = timeout;
+    }
+    _timersChanged();
 }
 
-template <class Client>
-void ClientBase<Client>::setRxTimeout(
+template <class Client, class Callbacks_>
+void ClientBase<Client, Callbacks_>::setConnectTimeout(
     std::optional<std::chrono::steady_clock::duration> timeout) {
-    _rx_timeout = timeout;
+    std::lock_guard lock(_writeMutex);
+    _connectTimeout = timeout;
+}
+
+template <class Client, class Callbacks_>
+void ClientBase<Client, Callbacks_>::setPollInterval(
+    std::optional<std::chrono::steady_clock::duration> interval) {
+    {
+        std::lock_guard lock(_writeMutex);
+        _pollInterval = interval;
+    }
+    _timersChanged();
 }
 
-template <class Client>
-void ClientBase<Client>::_close() {
+template <class Client, class Callbacks_>
+void ClientBase<Client, Callbacks_>::_close() {
     log_d_("Closing socket %d", _socket.load());
 
     _state = ConnectionState::DISCONNECTING;
-    ::close(_socket.exchange(-1));
+    const int socket = _socket.exchange(-1);
+    unwatch(static_cast<Client*>(this), socket);
+    {
+        std::lock_guard lock(_closeMutex);
+        ::close(socket);
+    }
 
     _clearWriteQueue();
+    {
+        std::lock_guard lock(_writeMutex);
+        _closeAttempts();
+    }
 }
 
-template <class Client>
-void ClientBase<Client>::_error(int errorCode) {
+template <class Client, class Callbacks_>
+void ClientBase<Client, Callbacks_>::_error(int errorCode) {
     _callbacks.template invoke<ClientCallbackType::ERROR>(errorCode);
 
     // We don't use _close_and_delete() here because _error() may be called with
@@ -361,41 +602,251 @@ void ClientBase<Client>::_error(int errorCode) {
     _close();
 }
 
-template <class Client>
-bool ClientBase<Client>::_processWriteQueue(std::unique_lock<std::mutex>&) {
-    // Assume we can write to the socket, calling this otherwise makes no sense.
-    // Also assume, that _writeMutex is locked.
+template <class Client, class Callbacks_>
+int ClientBase<Client, Callbacks_>::_startConnect(std::uint16_t port) {
+    const auto now = std::chrono::steady_clock::now();
+    int socket;
+    IPAddress ip;
+    {
+        std::lock_guard lock(_writeMutex);
+        _port = port;
+        _nextAddress = 0;
+        int error = 0;
+        socket = _openAttempt(ip, error);
+        if (socket < 0) {
+            log_e("connect to port %d failed for all %zu addresses, errno: %d (%s)", port,
+                  _addresses.count, error, strerror(error));
+            return error != 0 ? error : ERR_CONN;
+        }
 
-    bool activity = false;
-    for (auto& buf : _writeQueue) {
-        // Early bailout if this buffer already has an error for some reason
-        if (WriteQueueBufferUtil::hasError(buf)) {
-            break;
+        _ip = ip;
+        _connectDeadline = _connectTimeout ? now + *_connectTimeout
+                                           : std::chrono::steady_clock::time_point::max();
+        _nextAttempt = now + CONNECT_ATTEMPT_DELAY;
+    }
+
+    _state = ConnectionState::CONNECTING;
+
+    {
+        // Drop what was left unread from a previous connection
+        std::lock_guard lock(_recvMutex);
+        _recvRing.clear();
+        _recvPaused = false;
+        _unackedBytes = 0;
+        _ackLaterRequested = false;
+        _ackPaused = false;
+        _readPaused = false;
+    }
+
+    // Updating state visible to asyncTcpSock task
+    _socket = socket;
+    watch(static_cast<Client*>(this), socket);
+    {
+        // The socket becomes writable once connected
+        std::lock_guard lock(_writeMutex);
+        _setWriteInterest(true);
+    }
+    // The connect deadline, and possibly the next attempt
+    _timersChanged();
+
+    // Socket is now connecting. Should become writable in asyncTcpSock task, which then
+    // updates the state in _sockIsWritable().
+    log_i("connecting to %s:%d on socket %d", ip.toString().c_str(), port, socket);
+    return 0;
+}
+
+template <class Client, class Callbacks_>
+std::optional<int> ClientBase<Client, Callbacks_>::_finishConnect() {
+    std::lock_guard lock(_writeMutex);
+    const int primary = _socket;
+    if (primary < 0) {
+        // Closed in the meantime
+        return std::nullopt;
+    }
+
+    int error = 0;
+    if (_attempts.empty() && _nextAddress >= _addresses.count) {
+        // Nothing to race, the only socket has finished connecting
+        socklen_t errorSize = sizeof(error);
+        if (getsockopt(primary, SOL_SOCKET, SO_ERROR, &error, &errorSize) < 0) {
+            return errno;
         }
+        return error;
+    }
+
+    // Any of the racing sockets may be the one that became writable
+    const auto now = std::chrono::steady_clock::now();
+    int lastError = 0;
+    int winner = -1;
+    IPAddress winnerIp = _ip;
+    bool primaryFailed = false;
+    bool attemptFailed = false;
+    if (Platform::connectFinished(primary, error)) {
+        if (error == 0) {
+            winner = primary;
+        } else {
+            log_d_("connect to %s failed: %d", _ip.toString().c_str(), error);
+            lastError = error;
+            primaryFailed = true;
+        }
+    }
+    for (auto it = _attempts.begin(); winner < 0 && it != _attempts.end();) {
+        if (!Platform::connectFinished(it->socket, error)) {
+            ++it;
+        } else if (error == 0) {
+            winner = it->socket;
+            winnerIp = it->ip;
+            it = _attempts.erase(it);
+        } else {
+            log_d_("connect to %s failed: %d", it->ip.toString().c_str(), error);
+            lastError = error;
+            attemptFailed = true;
+            _discardSocket(it->socket);
+            it = _attempts.erase(it);
+        }
+    }
+
+    if (winner < 0) {
+        // RFC 8305 moves on to the next address as soon as an attempt fails
+        if (primaryFailed || attemptFailed) {
+            _addAttempt(now);
+        }
+        if (!primaryFailed) {
+            return std::nullopt;
+        }
+        if (_attempts.empty()) {
+            return lastError;
+        }
+
+        // A pending attempt takes the place of the failed socket
+        const ConnectAttempt replacement = _attempts.front();
+        if (_replaceSocket(primary, replacement.socket)) {
+            _attempts.erase(_attempts.begin());
+            _ip = replacement.ip;
+        }
+        return std::nullopt;
+    }
 
-        // Skip fully written buffers
-        if (WriteQueueBufferUtil::isFullyWritten(buf)) {
+    if (winner != primary && !_replaceSocket(primary, winner)) {
+        _discardSocket(winner);
+        return std::nullopt;
+    }
+    _ip = winnerIp;
+    _closeAttempts();
+    return 0;
+}
+
+template <class Client, class Callbacks_>
+void ClientBase<Client, Callbacks_>::_closeAttempts() {
+    for (const ConnectAttempt& attempt : _attempts) {
+        _discardSocket(attempt.socket);
+    }
+    _attempts.clear();
+    _nextAddress = _addresses.count;
+}
+
+template <class Client, class Callbacks_>
+int ClientBase<Client, Callbacks_>::_openAttempt(IPAddress& ip, int& error) {
+    while (_nextAddress < _addresses.count) {
+        ip = _addresses.addresses[_nextAddress++];
+
+        sockaddr_storage addr;
+        const socklen_t addrSize = _socketAddress(ip, _port, addr);
+        const int socket = ::socket(addr.ss_family, SOCK_STREAM, 0);
+        if (socket < 0) {
+            error = errno;
+            log_e("socket() error: %d", errno);
             continue;
         }
 
-        const std::size_t written = WriteQueueBufferUtil::write(buf, _socket);
-        _writeSpaceRemaining += written;
-        activity = activity || written > 0;
+        // Non-blocking first, so that connect() returns right away
+        errno = 0;
+        if (fcntl(socket, F_SETFL, fcntl(socket, F_GETFL, 0) | O_NONBLOCK) < 0 ||
+            (::connect(socket, reinterpret_cast<sockaddr*>(&addr), addrSize) < 0 &&
+             errno != EINPROGRESS)) {
+            // E.g. no route for the address family, the next address may do better
+            error = errno;
+            log_w("connect to %s:%d on socket %d failed, errno: %d (%s)",
+                  ip.toString().c_str(), _port, socket, errno, strerror(errno));
+            ::close(socket);
+            continue;
+        }
+
+        log_d_("connecting to %s:%d on socket %d", ip.toString().c_str(), _port, socket);
+        return socket;
     }
 
-    return activity;
+    return -1;
 }
 
-template <class Client>
-void ClientBase<Client>::_cleanupWriteQueue(std::unique_lock<std::mutex>& lock) {
+template <class Client, class Callbacks_>
+bool ClientBase<Client, Callbacks_>::_addAttempt(
+    std::chrono::steady_clock::time_point now) {
+    if (_socket < 0) {
+        // Closed, and the attempts with it
+        return false;
+    }
+
+    IPAddress ip;
+    int error = 0;
+    const int socket = _openAttempt(ip, error);
+    if (socket < 0) {
+        return false;
+    }
+
+    _attempts.push_back(ConnectAttempt{socket, ip});
+    watch(static_cast<Client*>(this), socket);
+    updateInterest(static_cast<Client*>(this), socket, true, true);
+    _nextAttempt = now + CONNECT_ATTEMPT_DELAY;
+    return true;
+}
+
+template <class Client, class Callbacks_>
+bool ClientBase<Client, Callbacks_>::_replaceSocket(int previous, int socket) {
+    // _close() takes the socket before the attempts
+    if (!_socket.compare_exchange_strong(previous, socket)) {
+        return false;
+    }
+
+    _discardSocket(previous);
+    return true;
+}
+
+template <class Client, class Callbacks_>
+void ClientBase<Client, Callbacks_>::_discardSocket(int socket) {
+    unwatch(static_cast<Client*>(this), socket);
+    ::close(socket);
+}
+
+template <class Client, class Callbacks_>
+bool ClientBase<Client, Callbacks_>::_processWriteQueue(std::unique_lock<std::mutex>&) {
+    // Assume we can write to the socket, calling this otherwise makes no sense.
+    // Also assume, that _writeMutex is locked.
+
+    // All pending buffers go out with as few writes as possible
+    const std::size_t written = WriteQueueBufferUtil::writeAll(_writeQueue, _socket);
+    _writeQueued -= written;
+    if (_lockFreeWrites) {
+        _submitUnwritten.fetch_sub(written, std::memory_order_relaxed);
+    }
+
+    return written > 0;
+}
+
+template <class Client, class Callbacks_>
+void ClientBase<Client, Callbacks_>::_cleanupWriteQueue(
+    std::unique_lock<std::mutex>& lock) {
     // Assume that _writeMutex is locked.
 
-    std::vector<WriteStats> notifyQueue;
-    notifyQueue.reserve(_writeQueue.size());
+    // Completions are reported from this inline list. Should more buffers finish at
+    // once, the excess is merged into the last entry.
+    static constexpr std::size_t MAX_NOTIFICATIONS = 16;
+    std::array<WriteStats, MAX_NOTIFICATIONS> notifyQueue;
+    std::size_t notifyCount = 0;
 
-    // Check front of queue for finished buffers and collect some stats about them.
-    std::size_t toRemove = 0;
-    for (const auto& buf : _writeQueue) {
+    // Pop finished buffers from the front of the queue and collect some stats about them.
+    while (!_writeQueue.empty()) {
+        const WriteQueueBuffer& buf = _writeQueue.front();
         if (WriteQueueBufferUtil::hasError(buf)) {
             lock.unlock();
             std::visit([&](auto&& it) { _error(it.errorCode); }, buf);
@@ -413,42 +864,314 @@ void ClientBase<Client>::_cleanupWriteQueue(std::unique_lock<std::mutex>& lock)
                     _rx_last_packet = it.writtenAt;
                 }
 
-                notifyQueue.emplace_back(WriteStats{
+                const WriteStats stats{
                     it.amountWritten,
                     std::chrono::duration_cast<
                         std::chrono::duration<std::uint32_t, std::milli>>(it.writtenAt -
-                                                                          it.queuedAt)});
+                                                                          it.queuedAt)};
+                if (notifyCount < notifyQueue.size()) {
+                    notifyQueue[notifyCount++] = stats;
+                } else {
+                    WriteStats& last = notifyQueue.back();
+                    last.length += stats.length;
+                    last.delay = std::max(last.delay, stats.delay);
+                }
             },
             buf);
-        ++toRemove;
+        _writeQueue.pop_front();
     }
 
-    _writeQueue.erase(_writeQueue.begin(), _writeQueue.begin() + toRemove);
+    if (_writeQueue.empty()) {
+        _setWriteInterest(false);
+    }
+
+    if (_lockFreeWrites && _submitRefused.exchange(false, std::memory_order_relaxed)) {
+        _writeAboveHigh = true;
+    }
+    const bool notifyWritable = _writeAboveHigh && _writeQueued <= _writeLowWatermark;
+    if (notifyWritable) {
+        _writeAboveHigh = false;
+    }
 
     // Unlock before we call any callbacks to avoid issues
     lock.unlock();
 
-    for (const WriteStats& stats : notifyQueue) {
-        _callbacks.template invoke<ClientCallbackType::SENT>(stats.length,
-                                                             stats.delay.count());
+    for (std::size_t i = 0; i < notifyCount; ++i) {
+        _callbacks.template invoke<ClientCallbackType::SENT>(
+            notifyQueue[i].length, notifyQueue[i].delay.count());
+    }
+
+    if (notifyWritable) {
+        _callbacks.template invoke<ClientCallbackType::WRITABLE>();
+    }
+}
+
+template <class Client, class Callbacks_>
+std::size_t ClientBase<Client, Callbacks_>::_writeSpace(bool includeSocket) const {
+    const std::size_t capacity =
+        _writeQueueLimit + (includeSocket ? Platform::socketSendSpace(_socket) : 0);
+    return capacity > _writeQueued ? capacity - _writeQueued : 0;
+}
+
+template <class Client, class Callbacks_>
+void ClientBase<Client, Callbacks_>::_appendToChunks(
+    std::span<const std::uint8_t> data, std::chrono::steady_clock::time_point now) {
+    while (!data.empty()) {
+        ChunkedWriteQueueBuffer* tail = nullptr;
+        if (!_writeQueue.empty()) {
+            tail = std::get_if<ChunkedWriteQueueBuffer>(&_writeQueue.back());
+        }
+        if (tail == nullptr || !tail->canAppend()) {
+            tail = &std::get<ChunkedWriteQueueBuffer>(
+                _writeQueue.emplace_back(ChunkedWriteQueueBuffer{
+                    {.queuedAt = now},
+                    std::unique_ptr<WriteChunk>(WriteChunk::pool().create()),
+                }));
+        }
+
+        data = data.subspan(tail->append(data));
+    }
+}
+
+template <class Client, class Callbacks_>
+WriteQueueBuffer ClientBase<Client, Callbacks_>::_makeBuffer(
+    std::span<const std::uint8_t> data,
+    ClientApiFlags apiFlags,
+    std::chrono::steady_clock::time_point now) {
+    if (apiFlags.test(ClientApiFlag::COPY)) {
+        return OwnedWriteQueueBuffer{
+            {.queuedAt = now},
+            std::vector<std::uint8_t>(data.begin(), data.end()),
+        };
+    }
+    return BorrowedWriteQueueBuffer{{.queuedAt = now}, data};
+}
+
+template <class Client, class Callbacks_>
+void ClientBase<Client, Callbacks_>::_enqueue(WriteQueueBuffer&& buf,
+                                              std::span<const std::uint8_t> data,
+                                              bool coalesce,
+                                              std::chrono::steady_clock::time_point now) {
+    if (coalesce) {
+        _appendToChunks(data, now);
+    } else {
+        _writeQueue.push_back(std::move(buf));
+    }
+    _writeQueued += data.size();
+    if (_writeQueued >= _writeHighWatermark) {
+        _writeAboveHigh = true;
     }
+    _ack_timeout_signaled = false;
+    _setWriteInterest(true);
 }
 
-template <class Client>
-void ClientBase<Client>::_clearWriteQueue() {
+template <class Client, class Callbacks_>
+std::optional<std::size_t> ClientBase<Client, Callbacks_>::_writeDirect(
+    const std::uint8_t* data,
+    std::size_t size,
+    ClientApiFlags apiFlags) {
+    std::unique_lock lock(_writeMutex);
+    if (_lockFreeWrites || !_writeQueue.empty()) {
+        // Queued data goes first
+        return std::nullopt;
+    }
+
+    errno = 0;
+    const ssize_t result = Platform::socketWrite(_socket, data, size);
+    if (result < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+        // Queued instead, the manager reports the error once it writes
+        return std::nullopt;
+    }
+
+    const std::size_t written = result > 0 ? result : 0;
+    const auto now = std::chrono::steady_clock::now();
+    if (written > 0 && _callbacks.template has<ClientCallbackType::SENT>()) {
+        // The manager reports the written bytes to onAck when it cleans up the queue.
+        // The record holds no data and is skipped by writes.
+        _writeQueue.push_back(BorrowedWriteQueueBuffer{
+            {.amountWritten = written, .queuedAt = now, .writtenAt = now}});
+        _setWriteInterest(true);
+    }
+
+    // The socket is full, only the queue limit is left for the rest
+    const std::span<const std::uint8_t> rest(data + written, size - written);
+    const std::size_t toQueue = std::min(rest.size(), _writeSpace(false));
+    if (toQueue < rest.size()) {
+        _writeAboveHigh = true;
+    }
+    if (toQueue > 0) {
+        const bool coalesce =
+            apiFlags.test(ClientApiFlag::COPY) && toQueue <= WriteChunk::SIZE;
+        WriteQueueBuffer buf;
+        if (!coalesce) {
+            buf = _makeBuffer(rest.first(toQueue), apiFlags, now);
+        }
+        _enqueue(std::move(buf), rest.first(toQueue), coalesce, now);
+    }
+
+    log_d_("Wrote %zu bytes directly and queued %zu, socket %d", written, toQueue,
+           _socket.load());
+
+    return written + toQueue;
+}
+
+template <class Client, class Callbacks_>
+void ClientBase<Client, Callbacks_>::_clearWriteQueue() {
     std::lock_guard lock(_writeMutex);
+    // Submissions still arriving are dropped by _sockSubmitted()
+    if (_lockFreeWrites) {
+        _takeSubmitted();
+        _submitUnwritten.fetch_sub(_writeQueued, std::memory_order_relaxed);
+        _submitRefused = false;
+    }
     _writeQueue.clear();
-    _writeSpaceRemaining = INITIAL_WRITE_SPACE;
+    _writeQueued = 0;
+    _writeAboveHigh = false;
+    // The socket has already been unwatched, no need to notify the manager. A new one
+    // is watched for reading again.
+    _readInterest = true;
+    _writeInterest = false;
 }
 
-template <class Client>
-bool ClientBase<Client>::_checkAckTimeout() {
-    if (_ack_timeout_signaled || !_ack_timeout)
-        // Handler already called or no timeout set, continue normally.
+template <class Client, class Callbacks_>
+std::size_t ClientBase<Client, Callbacks_>::_submit(const std::uint8_t* data,
+                                                    std::size_t size,
+                                                    ClientApiFlags apiFlags) {
+    // Concurrent submissions may together exceed the limit a little
+    const std::size_t limit = _writeQueueLimit.load(std::memory_order_relaxed);
+    const std::size_t unwritten = _submitUnwritten.load(std::memory_order_relaxed);
+    const std::size_t toSend = std::min(limit > unwritten ? limit - unwritten : 0, size);
+    if (toSend < size) {
+        _submitRefused.store(true, std::memory_order_relaxed);
+        if (toSend == 0) {
+            return 0;
+        }
+    }
+
+    const auto now = std::chrono::steady_clock::now();
+    WriteQueueBuffer buf;
+    if (apiFlags.test(ClientApiFlag::COPY)) {
+        buf.emplace<OwnedWriteQueueBuffer>(OwnedWriteQueueBuffer{
+            {.queuedAt = now},
+            std::vector<std::uint8_t>(data, data + toSend),
+        });
+    } else {
+        buf.emplace<BorrowedWriteQueueBuffer>(BorrowedWriteQueueBuffer{
+            {.queuedAt = now},
+            std::span<const std::uint8_t>(data, toSend),
+        });
+    }
+    auto* write = new SubmittedWrite{{}, std::move(buf), toSend};
+
+    _submitUnwritten.fetch_add(toSend, std::memory_order_relaxed);
+    _submitted.push(write);
+    // One signal until the manager takes the submissions
+    if (!_submitPending.exchange(true, std::memory_order_acq_rel)) {
+        signalSubmitted(static_cast<Client*>(this));
+    }
+
+    log_d_("Submitted %zu bytes for sending, socket %d", toSend, _socket.load());
+
+    return toSend;
+}
+
+template <class Client, class Callbacks_>
+std::size_t ClientBase<Client, Callbacks_>::_takeSubmitted() {
+    // Cleared first: a producer whose node is missing below signals again
+    _submitPending.exchange(false, std::memory_order_acq_rel);
+
+    std::size_t taken = 0;
+    while (SubmittedWrite* write = _submitted.pop()) {
+        taken += write->size;
+        _writeQueue.push_back(std::move(write->buffer));
+        delete write;
+    }
+    _writeQueued += taken;
+
+    return taken;
+}
+
+template <class Client, class Callbacks_>
+void ClientBase<Client, Callbacks_>::_setReadInterest(bool readInterest) {
+    if (_readInterest == readInterest) {
+        return;
+    }
+
+    _readInterest = readInterest;
+    updateInterest(static_cast<Client*>(this), _socket.load(), readInterest,
+                   _writeInterest);
+}
+
+template <class Client, class Callbacks_>
+void ClientBase<Client, Callbacks_>::_setWriteInterest(bool writeInterest) {
+    if (_writeInterest == writeInterest) {
+        return;
+    }
+
+    _writeInterest = writeInterest;
+    updateInterest(static_cast<Client*>(this), _socket.load(), _readInterest,
+                   writeInterest);
+}
+
+template <class Client, class Callbacks_>
+void ClientBase<Client, Callbacks_>::_updateReadInterest() {
+    std::lock_guard writeLock(_writeMutex);
+    _setReadInterest(!_recvPaused && !_ackPaused && !_readPaused);
+}
+
+template <class Client, class Callbacks_>
+bool ClientBase<Client, Callbacks_>::_deferAck(std::size_t size) {
+    std::lock_guard lock(_recvMutex);
+    if (!_ackLaterRequested) {
         return false;
+    }
+
+    _ackLaterRequested = false;
+    _unackedBytes += size;
+    if (_unackedBytes > _ackWatermark && !_ackPaused) {
+        // ack() resumes once enough of the data has been acknowledged
+        _ackPaused = true;
+        _updateReadInterest();
+    }
+
+    return _ackPaused;
+}
 
+template <class Client, class Callbacks_>
+std::span<std::uint8_t> ClientBase<Client, Callbacks_>::_receiveSpace() {
+    std::lock_guard lock(_recvMutex);
+    const std::span<std::uint8_t> space = _recvRing.writable();
+    if (space.empty()) {
+        // read() resumes once the application made room
+        _recvPaused = true;
+        _updateReadInterest();
+    }
+
+    return space;
+}
+
+template <class Client, class Callbacks_>
+void ClientBase<Client, Callbacks_>::_receiveCommit(std::size_t size) {
+    bool wasEmpty;
+    {
+        std::lock_guard lock(_recvMutex);
+        wasEmpty = _recvRing.empty();
+        _recvRing.commit(size);
+    }
+
+    if (wasEmpty) {
+        _callbacks.template invoke<ClientCallbackType::AVAILABLE>();
+    }
+}
+
+template <class Client, class Callbacks_>
+bool ClientBase<Client, Callbacks_>::_checkAckTimeout() {
     std::unique_lock lock(_writeMutex);
 
+    if (_ack_timeout_signaled || !_ack_timeout)
+        // Handler already called or no timeout set, continue normally.
+        return false;
+
     if (!_writeQueue.empty()) {
         // Check the first element in the queue to see how long it's been waiting to be
         // sent.
@@ -472,28 +1195,27 @@ bool ClientBase<Client>::_checkAckTimeout() {
     return false;
 }
 
-template <class Client>
-bool ClientBase<Client>::_checkRxTimeout() {
-    if (!_rx_timeout)
+template <class Client, class Callbacks_>
+bool ClientBase<Client, Callbacks_>::_checkRxTimeout() {
+    std::optional<std::chrono::steady_clock::duration> timeout;
+    {
+        std::lock_guard lock(_writeMutex);
+        timeout = _rx_timeout;
+    }
+
+    if (!timeout)
         return false;
 
     const auto now = std::chrono::steady_clock::now();
-    if (now - _rx_last_packet < _rx_timeout)
+    if (now - _rx_last_packet < *timeout)
         return false;
 
     {
-        // Check if this socket can even be read. It may be the case that the select(...)
-        // call in the manager task fails because any of the sockets is not readable or
-        // writable, but we only want to time out if we are the problematic socket.
-
-        fd_set sockSet_r{};
-        timeval timeout{};
-        FD_ZERO(&sockSet_r);
-        FD_SET(_socket, &sockSet_r);
-
-        int selected = select(_socket + 1, &sockSet_r, nullptr, nullptr, &timeout);
-        if (selected > 0) {
-            // This socket is still readable. Reset timeout.
+        // The manager runs the readable sockets of a wait before the passed deadlines,
+        // so data that arrived in time has been read already. Only while reading is
+        // paused the socket isn't watched, but then we are the ones not reading.
+        std::lock_guard lock(_recvMutex);
+        if (_recvPaused || _ackPaused || _readPaused) {
             _rx_last_packet = now;
             return false;
         }
@@ -504,41 +1226,49 @@ bool ClientBase<Client>::_checkRxTimeout() {
     return true;
 }
 
-template <class Client>
-bool ClientBase<Client>::_pendingWrite() {
-    // Mark this socket as eligible for write polling if it is not fully connected yet or
-    // if there is something in the queue, regardless of connection state.
-    return (_state != ConnectionState::DISCONNECTED &&
-            _state != ConnectionState::CONNECTED) ||
-           [&]() {
-               if (!_writeMutex.try_lock()) {
-                   // Assume we have something to write if someone else is currently
-                   // writing. Even if the queue were empty, it shouldn't be an issue.
-                   // This prevents stalling the caller until everything is written.
-                   return true;
-               }
-               std::lock_guard lock(_writeMutex, std::adopt_lock);
-               return !_writeQueue.empty();
-           }();
-}
-
-template <class Client>
-bool ClientBase<Client>::_sockIsWriteable() {
+template <class Client, class Callbacks_>
+void ClientBase<Client, Callbacks_>::_sockSubmitted() {
+    std::unique_lock lock(_writeMutex);
+    if (_takeSubmitted() == 0) {
+        return;
+    }
+
+    if (!connected()) {
+        // Submitted while the connection closed
+        _submitUnwritten.fetch_sub(_writeQueued, std::memory_order_relaxed);
+        _writeQueue.clear();
+        _writeQueued = 0;
+        return;
+    }
+
+    if (_writeQueued >= _writeHighWatermark) {
+        _writeAboveHigh = true;
+    }
+    _ack_timeout_signaled = false;
+
+    // Whatever the socket doesn't take now goes out once it is writable
+    _processWriteQueue(lock);
+    _setWriteInterest(true);
+    _cleanupWriteQueue(lock);
+}
+
+template <class Client, class Callbacks_>
+void ClientBase<Client, Callbacks_>::_timersChanged() {
+    signalTimersChanged(static_cast<Client*>(this));
+}
+
+template <class Client, class Callbacks_>
+bool ClientBase<Client, Callbacks_>::_sockIsWriteable() {
     bool activity = false;
 
     // Socket is now writeable. What should we do?
     if (_state != ConnectionState::CONNECTED) {
-        // Socket has finished connecting, check status
-        socklen_t socketErrorSize = sizeof(int);
-        int socketError = 0;
-        int result =
-            getsockopt(_socket, SOL_SOCKET, SO_ERROR, &socketError, &socketErrorSize);
-
-        if (result < 0) {
-            _error(errno);
+        // A socket has finished connecting, check status
+        const std::optional<int> socketError = _finishConnect();
+        if (!socketError) {
             return false;
-        } else if (socketError != 0) {
-            _error(socketError);
+        } else if (*socketError != 0) {
+            _error(*socketError);
             return false;
         }
 
@@ -552,49 +1282,232 @@ bool ClientBase<Client>::_sockIsWriteable() {
 
     {
         std::unique_lock lock(_writeMutex);
-        if (_state == ConnectionState::CONNECTED && _writeQueue.size() > 0) {
-            // We are connected. Write available data.
-            activity = _processWriteQueue(lock);
-            _cleanupWriteQueue(lock);
+        if (_state == ConnectionState::CONNECTED) {
+            if (_writeQueue.empty()) {
+                // Nothing (more) to write, e.g. right after connecting
+                _setWriteInterest(false);
+            } else {
+                // We are connected. Write available data.
+                activity = _processWriteQueue(lock);
+                _cleanupWriteQueue(lock);
+            }
         }
     }
 
     return activity;
 }
 
-template <class Client>
-void ClientBase<Client>::_sockIsReadable() {
-    errno = 0;
+template <class Client, class Callbacks_>
+void ClientBase<Client, Callbacks_>::_sockIsReadable(std::span<std::uint8_t> scratch) {
+    // Drain the socket until it would block or the budget is used up. Anything left is
+    // picked up in the next turn of the manager loop, after the other sockets.
+    if (!connected()) {
+        // Connecting, where failures are reported as writability, or closed already
+        return;
+    }
 
-    ssize_t result =
-        lwip_read(_socket, SHARED_READ_BUFFER.data(), SHARED_READ_BUFFER.size());
+    bool readPaused;
+    {
+        // Readiness may have been reported before reading was paused
+        std::lock_guard lock(_recvMutex);
+        readPaused = _readPaused || _ackPaused;
+    }
 
-    if (result > 0) {
-        _rx_last_packet = std::chrono::steady_clock::now();
-        // result contains the amount of data read
-        _callbacks.template invoke<ClientCallbackType::RECV>(SHARED_READ_BUFFER.data(),
-                                                             result);
-    } else if (result == 0) {
-        // A successful read of 0 bytes indicates that the remote side closed the
-        // connection
+    if (readPaused) {
+        _checkHangup();
+        return;
+    }
+
+    std::size_t budget = _readBudget;
+    while (budget > 0) {
+        // In pull mode, read into the receive ring. With an onBuffer handler, read
+        // straight into storage the application can keep.
+        std::span<std::uint8_t> target = scratch;
+        std::unique_ptr<RecvBlock> block;
+        if (_recvRing.capacity() > 0) {
+            target = _receiveSpace();
+            if (target.empty()) {
+                // Read interest was dropped, only errors and hangups are left to report
+                if (budget == _readBudget) {
+                    _checkHangup();
+                }
+                return;
+            }
+        } else if (_callbacks.template has<ClientCallbackType::RECV_BUFFER>()) {
+            block.reset(RecvBlock::pool().create());
+            target = block->bytes;
+        }
+
+        const std::size_t size = std::min(budget, target.size());
+
+        errno = 0;
+        ssize_t result = Platform::socketRead(_socket, target.data(), size);
+
+        if (result > 0) {
+            _rx_last_packet = std::chrono::steady_clock::now();
+            // result contains the amount of data read
+            if (_recvRing.capacity() > 0) {
+                _receiveCommit(result);
+            } else {
+                if (block) {
+                    _callbacks.template invoke<ClientCallbackType::RECV_BUFFER>(
+                        RecvBuffer(block.release(), result));
+                } else {
+                    _callbacks.template invoke<ClientCallbackType::RECV>(target.data(),
+                                                                         result);
+                }
+
+                // The callback may have deferred the acknowledgement with ackLater()
+                if (_deferAck(result)) {
+                    return;
+                }
+            }
+        } else if (result == 0) {
+            // A successful read of 0 bytes indicates that the remote side closed the
+            // connection
+            _close();
+            return;
+        } else {
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                // Errors other than these should be handled
+                _error(errno);
+            }
+            return;
+        }
+
+        // A short read means the socket is drained, don't spend a call on EAGAIN. The
+        // callback may also have closed the connection.
+        if (static_cast<std::size_t>(result) < size || !isOpen()) {
+            return;
+        }
+
+        budget -= result;
+    }
+}
+
+template <class Client, class Callbacks_>
+void ClientBase<Client, Callbacks_>::_checkHangup() {
+    std::uint8_t byte;
+    errno = 0;
+    const ssize_t result = Platform::socketPeek(_socket, &byte, sizeof(byte));
+    if (result == 0) {
         _close();
-    } else if (errno != EAGAIN && errno != EWOULDBLOCK) {
-        // Errors other than these should be handled
+    } else if (result < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
         _error(errno);
+    } else if (result > 0) {
+        // A reset behind unread data only shows in the socket's error
+        int error = 0;
+        socklen_t errorSize = sizeof(error);
+        if (getsockopt(_socket, SOL_SOCKET, SO_ERROR, &error, &errorSize) == 0 &&
+            error != 0) {
+            _error(error);
+        }
     }
 }
 
-template <class Client>
-void ClientBase<Client>::_sockDelayedConnect() {
-    if (_ip) {
-        connect(_ip, _port);
-    } else {
+template <class Client, class Callbacks_>
+void ClientBase<Client, Callbacks_>::_sockDelayedConnect() {
+    if (_state != ConnectionState::WAITING_FOR_DNS) {
+        // The lookup timed out before
+        return;
+    }
+
+    bool resolved;
+    std::uint16_t port;
+    {
+        std::lock_guard lock(_writeMutex);
+        resolved = _addresses.count > 0;
+        port = _port;
+    }
+
+    if (!resolved) {
         _error(ERR_DNS_RESOLUTION_FAILED);
+    } else if (const int error = _startConnect(port); error != 0) {
+        _error(error);
     }
 }
 
-template <class Client>
-void ClientBase<Client>::_sockPoll() {
+template <class Client, class Callbacks_>
+std::chrono::steady_clock::time_point ClientBase<Client, Callbacks_>::_nextDeadline()
+    const {
+    using Clock = std::chrono::steady_clock;
+
+    if (_state == ConnectionState::WAITING_FOR_DNS) {
+        std::lock_guard lock(_writeMutex);
+        return _dnsDeadline;
+    }
+    if (_state == ConnectionState::CONNECTING) {
+        std::lock_guard lock(_writeMutex);
+        return _nextAddress < _addresses.count ? std::min(_connectDeadline, _nextAttempt)
+                                               : _connectDeadline;
+    }
+    if (!connected()) {
+        return Clock::time_point::max();
+    }
+
+    std::lock_guard lock(_writeMutex);
+    Clock::time_point next = Clock::time_point::max();
+    if (_pollInterval && _callbacks.template has<ClientCallbackType::POLL>()) {
+        next = std::max(getLastActive(), _lastPoll) + *_pollInterval;
+    }
+    if (_rx_timeout) {
+        next = std::min(next, _rx_last_packet + *_rx_timeout);
+    }
+    if (_ack_timeout && !_ack_timeout_signaled) {
+        // Only the oldest buffer can time out, see _checkAckTimeout()
+        if (!_writeQueue.empty()) {
+            const auto& first = WriteQueueBufferUtil::asCommonView(_writeQueue.front());
+            if (first.writtenAt == Clock::time_point{}) {
+                next = std::min(next, first.queuedAt + *_ack_timeout);
+            }
+        }
+    }
+
+    return next;
+}
+
+template <class Client, class Callbacks_>
+void ClientBase<Client, Callbacks_>::_sockPoll() {
+    // Any of the deadlines of _nextDeadline() may have passed, or none if they moved
+    const auto now = std::chrono::steady_clock::now();
+
+    if (_state == ConnectionState::WAITING_FOR_DNS) {
+        bool timedOut;
+        {
+            std::lock_guard lock(_writeMutex);
+            timedOut = now >= _dnsDeadline;
+        }
+        if (timedOut) {
+            log_e("DNS resolution timed out");
+            // The lookup goes on for other clients waiting for the same name
+            DnsCache::instance().cancel(this);
+            _error(ERR_DNS_RESOLUTION_FAILED);
+        }
+        return;
+    }
+
+    if (_state == ConnectionState::CONNECTING) {
+        bool timedOut;
+        IPAddress ip;
+        std::uint16_t port;
+        {
+            std::lock_guard lock(_writeMutex);
+            timedOut = now >= _connectDeadline;
+            ip = _ip;
+            port = _port;
+            if (!timedOut && now >= _nextAttempt) {
+                // The attempts so far take long, race the next address
+                _addAttempt(now);
+            }
+        }
+
+        if (timedOut) {
+            log_e("connect to %s:%d timed out", ip.toString().c_str(), port);
+            _error(ERR_TIMEOUT);
+        }
+        return;
+    }
+
     // We can be DISCONNECTED but also have a valid socket
     if (!connected())
         return;
@@ -617,16 +1530,39 @@ void ClientBase<Client>::_sockPoll() {
     }
 
     if (_checkRxTimeout()) {
-        // A receive timeout will close the connection if the socket is no more readable
+        // A receive timeout closes the connection
         _close();
         return;
     }
 
-    _callbacks.template invoke<ClientCallbackType::POLL>();
+    std::optional<std::chrono::steady_clock::duration> pollInterval;
+    {
+        std::lock_guard lock(_writeMutex);
+        pollInterval = _pollInterval;
+    }
+
+    if (pollInterval && now >= std::max(getLastActive(), _lastPoll) + *pollInterval) {
+        _lastPoll = now;
+        _callbacks.template invoke<ClientCallbackType::POLL>();
+    }
+}
+
+template <class Client, class Callbacks_>
+void ClientBase<Client, Callbacks_>::_sockReleased() {
+    std::function<void()> release;
+    {
+        std::lock_guard lock(_writeMutex);
+        release = std::exchange(_release, nullptr);
+    }
+
+    // May delete the client
+    if (release) {
+        release();
+    }
 }
 
-template <class Client>
-void ClientBase<Client>::_processingDone() {
+template <class Client, class Callbacks_>
+void ClientBase<Client, Callbacks_>::_processingDone() {
     if (_state == ConnectionState::DISCONNECTING) {
         _state = ConnectionState::DISCONNECTED;
         log_d_("Firing disconnect for client %p", this);
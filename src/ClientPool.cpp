@@ -0,0 +1,205 @@
+#include "ClientPool.hpp"
+
+#include <iterator>
+#include <utility>
+
+#include "SslClient.hpp"
+
+using namespace AsyncTcpSock;
+
+// Nothing of the previous user may run while the client is idle. Clearing the poll
+// handler also removes the poll deadline.
+static void clearHandlers(Client* client) {
+    client->onConnect(nullptr);
+    client->onDisconnect(nullptr);
+    client->onPoll(nullptr);
+    client->onAck(nullptr);
+    client->onWritable(nullptr);
+    client->onData(nullptr);
+    client->onBuffer(nullptr);
+    client->onAvailable(nullptr);
+    client->onError(nullptr);
+    client->onTimeout(nullptr);
+}
+
+// The manager task may still be busy with the client, for example with its
+// disconnection, so it is deleted there
+static void deleteLater(Client* client) {
+    client->releaseLater([client]() { delete client; });
+}
+
+ClientPool::~ClientPool() noexcept {
+    clear();
+}
+
+Client* ClientPool::acquire(const char* host, std::uint16_t port, bool tls) {
+    Key key{host, port, tls};
+    Client* client = nullptr;
+    std::vector<Client*> closing;
+    {
+        std::lock_guard lock(_mutex);
+        _prune(Clock::now(), closing);
+
+        // The most recently used one is the least likely to have been closed by the peer
+        auto it = _idle.find(key);
+        while (it != _idle.end() && !it->second.empty() && client == nullptr) {
+            Client* candidate = it->second.back().client;
+            it->second.pop_back();
+            if (candidate->reusable()) {
+                client = candidate;
+            } else {
+                closing.push_back(candidate);
+            }
+        }
+        if (it != _idle.end() && it->second.empty()) {
+            _idle.erase(it);
+        }
+    }
+
+    for (Client* closed : closing) {
+        deleteLater(closed);
+    }
+
+    if (client != nullptr) {
+        // Still paused, what the peer sends next is for the caller's handlers
+        log_d_("Reusing connection to %s:%u", host, port);
+    } else {
+        client = tls ? new SslClient() : new Client();
+    }
+
+    std::lock_guard lock(_mutex);
+    _lent.insert_or_assign(client, std::move(key));
+    return client;
+}
+
+void ClientPool::release(Client* client) {
+    if (client == nullptr) {
+        return;
+    }
+
+    Key key{};
+    {
+        std::lock_guard lock(_mutex);
+        const auto lent = _lent.find(client);
+        if (lent == _lent.end()) {
+            log_e("Client %p wasn't acquired from this pool", static_cast<void*>(client));
+            return;
+        }
+        key = std::move(lent->second);
+        _lent.erase(lent);
+    }
+
+    // Nothing more is delivered. The handlers may be running right now, so they are
+    // only cleared once they have returned.
+    client->setReadPaused(true);
+    client->releaseLater([this, client, key = std::move(key)]() mutable {
+        _store(client, std::move(key));
+    });
+}
+
+void ClientPool::discard(Client* client) {
+    if (client == nullptr) {
+        return;
+    }
+
+    {
+        std::lock_guard lock(_mutex);
+        if (_lent.erase(client) == 0) {
+            log_e("Client %p wasn't acquired from this pool", static_cast<void*>(client));
+            return;
+        }
+    }
+
+    deleteLater(client);
+}
+
+void ClientPool::setMaxIdle(std::size_t maxIdle) {
+    std::lock_guard lock(_mutex);
+    _maxIdle = maxIdle;
+}
+
+void ClientPool::setMaxIdleAge(Clock::duration maxIdleAge) {
+    std::lock_guard lock(_mutex);
+    _maxIdleAge = maxIdleAge;
+}
+
+std::size_t ClientPool::idle() const {
+    std::lock_guard lock(_mutex);
+    std::size_t count = 0;
+    for (const auto& [key, idle] : _idle) {
+        count += idle.size();
+    }
+    return count;
+}
+
+void ClientPool::prune() {
+    std::vector<Client*> closing;
+    {
+        std::lock_guard lock(_mutex);
+        _prune(Clock::now(), closing);
+    }
+
+    for (Client* closed : closing) {
+        deleteLater(closed);
+    }
+}
+
+void ClientPool::clear() {
+    std::vector<Client*> closing;
+    {
+        std::lock_guard lock(_mutex);
+        for (const auto& [key, idle] : _idle) {
+            for (const Idle& entry : idle) {
+                closing.push_back(entry.client);
+            }
+        }
+        _idle.clear();
+    }
+
+    for (Client* closed : closing) {
+        deleteLater(closed);
+    }
+}
+
+void ClientPool::_store(Client* client, Key key) {
+    clearHandlers(client);
+    if (!client->reusable()) {
+        delete client;
+        return;
+    }
+
+    std::vector<Client*> closing;
+    {
+        std::lock_guard lock(_mutex);
+        const auto now = Clock::now();
+        _prune(now, closing);
+
+        std::vector<Idle>& idle = _idle[std::move(key)];
+        idle.push_back(Idle{client, now});
+        while (idle.size() > _maxIdle) {
+            closing.push_back(idle.front().client);
+            idle.erase(idle.begin());
+        }
+    }
+
+    for (Client* closed : closing) {
+        deleteLater(closed);
+    }
+}
+
+void ClientPool::_prune(Clock::time_point now, std::vector<Client*>& closing) {
+    for (auto it = _idle.begin(); it != _idle.end();) {
+        // Also those the peer closed meanwhile, which select() doesn't report for
+        // sockets that aren't read
+        std::vector<Idle>& idle = it->second;
+        std::erase_if(idle, [&](const Idle& entry) {
+            if (now - entry.since < _maxIdleAge && entry.client->reusable()) {
+                return false;
+            }
+            closing.push_back(entry.client);
+            return true;
+        });
+
+        it = idle.empty() ? _idle.erase(it) : std::next(it);
+    }
+}
@@ -0,0 +1,116 @@
+#ifndef ASYNCTCPSOCK_CLIENTPOOL_HPP
+#define ASYNCTCPSOCK_CLIENTPOOL_HPP
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Client.hpp"
+#include "Configuration.hpp"
+
+namespace AsyncTcpSock {
+
+/**
+ * Established outbound connections kept for reuse, keyed by host, port and whether they
+ * use TLS. A client taken with acquire() is handed back with release() once its exchange
+ * is complete; if it can carry another request, it waits for the next acquire() instead
+ * of being closed, which saves the TCP and TLS handshakes.
+ *
+ * Idle clients don't read, so that a FIN or stray data from the peer stays in the socket
+ * until acquire() checks for it. At most maxIdle clients are kept per key, for at most
+ * maxIdleAge each.
+ *
+ * TLS connections are rarely reused: the check sees the encrypted stream, so records
+ * nobody asked for, such as the session tickets a TLS 1.3 server sends after the
+ * handshake, count as unread data.
+ */
+class ClientPool {
+  public:
+    using Clock = std::chrono::steady_clock;
+
+    static constexpr std::size_t DEFAULT_MAX_IDLE = CONFIG_ASYNC_TCP_POOL_MAX_IDLE;
+    static constexpr std::chrono::milliseconds DEFAULT_MAX_IDLE_AGE{
+        CONFIG_ASYNC_TCP_POOL_MAX_IDLE_AGE};
+
+  private:
+    struct Key {
+        std::string host;
+        std::uint16_t port;
+        bool tls;
+
+        bool operator==(const Key& other) const = default;
+    };
+
+    struct KeyHash {
+        std::size_t operator()(const Key& key) const {
+            return std::hash<std::string>()(key.host) ^
+                   (std::size_t(key.port) << 1 | std::size_t(key.tls));
+        }
+    };
+
+    struct Idle {
+        Client* client;
+        Clock::time_point since;
+    };
+
+    mutable std::mutex _mutex{};
+    // Oldest first
+    std::unordered_map<Key, std::vector<Idle>, KeyHash> _idle{};
+    // Clients handed out by acquire(), with the key they return to
+    std::unordered_map<Client*, Key> _lent{};
+    std::size_t _maxIdle = DEFAULT_MAX_IDLE;
+    Clock::duration _maxIdleAge = DEFAULT_MAX_IDLE_AGE;
+
+  public:
+    ClientPool() = default;
+    /// Has the manager task delete the idle clients. Those still lent out are left to
+    /// their users. Must not run while a release() is still pending.
+    ~ClientPool() noexcept;
+
+    ClientPool(const ClientPool& other) = delete;
+    ClientPool(ClientPool&& other) = delete;
+
+    ClientPool& operator=(const ClientPool& other) = delete;
+    ClientPool& operator=(ClientPool&& other) = delete;
+
+    /// An idle client connected to host:port, or a new one that isn't connected yet.
+    /// Install the handlers, then call setReadPaused(false) if it is connected(), an idle
+    /// client doesn't read until then, or connect(host, port) otherwise. A new client is
+    /// an SslClient if tls is set.
+    Client* acquire(const char* host, std::uint16_t port, bool tls = false);
+    /// Hand back a client from acquire(), possibly from its own callbacks. It stops
+    /// reading right away; once its callbacks have returned, the manager task clears its
+    /// handlers and keeps it for acquire() or deletes it if it can't be reused. Other
+    /// settings carry over to the next user.
+    void release(Client* client);
+    /// Delete a client from acquire() instead of handing it back, for example after its
+    /// connection failed. Once the callbacks have returned, like release().
+    void discard(Client* client);
+
+    /// Idle clients kept per key, 0 closes every client on release
+    void setMaxIdle(std::size_t maxIdle);
+    /// How long a client may stay idle before it is closed
+    void setMaxIdleAge(Clock::duration maxIdleAge);
+
+    /// Number of idle clients
+    std::size_t idle() const;
+    /// Close idle clients that are too old. acquire() and release() do so as well.
+    void prune();
+    /// Close all idle clients
+    void clear();
+
+  private:
+    // Assumes that _mutex is locked. Moves the clients to be deleted to closing, so that
+    // they are handed to the manager task without the lock.
+    void _prune(Clock::time_point now, std::vector<Client*>& closing);
+    // Second half of release(), run by the manager task outside the client's callbacks
+    void _store(Client* client, Key key);
+};
+
+}  // namespace AsyncTcpSock
+
+#endif
@@ -1,16 +1,14 @@
 #ifndef ASYNCTCPSOCK_CONFIGURATION_HPP
 #define ASYNCTCPSOCK_CONFIGURATION_HPP
 
-#define ASYNC_TCP_ENABLE_DEBUG_LOG 0
-#if ASYNC_TCP_ENABLE_DEBUG_LOG
-#include <esp32-hal-log.h>
-#define log_d_(...) log_d(__VA_ARGS__)
-#else
-#define log_d_(...) \
-    do {            \
-    } while (0)
+// The defaults below follow ESP-IDF's settings (CONFIG_LWIP_*), and this header comes
+// before any of ESP-IDF's
+#if __has_include(<sdkconfig.h>)
+#include <sdkconfig.h>
 #endif
 
+#define ASYNC_TCP_ENABLE_DEBUG_LOG 0
+
 #ifndef CONFIG_ASYNC_TCP_RUNNING_CORE
 // If core is not defined, then we are running in Arduino or PIO
 #define CONFIG_ASYNC_TCP_RUNNING_CORE -1  // any available core
@@ -26,6 +24,7 @@
 #endif
 
 #ifndef CONFIG_ASYNC_TCP_POLL_INTERVAL
+// Default interval of onPoll in milliseconds, see setPollInterval()
 #define CONFIG_ASYNC_TCP_POLL_INTERVAL 125
 #endif
 
@@ -37,8 +36,172 @@
 #define CONFIG_ASYNC_TCP_MAX_ACK_TIME 5000
 #endif
 
+#ifndef CONFIG_ASYNC_TCP_DNS_TIMEOUT
+// Milliseconds connect() waits for an asynchronous DNS lookup before failing
+#define CONFIG_ASYNC_TCP_DNS_TIMEOUT 10000
+#endif
+
+#ifndef CONFIG_ASYNC_TCP_DNS_CACHE_SIZE
+// Host names whose lookup results are kept, see DnsCache
+#define CONFIG_ASYNC_TCP_DNS_CACHE_SIZE 16
+#endif
+
+#ifndef CONFIG_ASYNC_TCP_DNS_CACHE_TTL
+// Milliseconds a resolved address is reused. Neither LWIP nor getaddrinfo() report the
+// TTL of the record.
+#define CONFIG_ASYNC_TCP_DNS_CACHE_TTL 60000
+#endif
+
+#ifndef CONFIG_ASYNC_TCP_DNS_NEGATIVE_TTL
+// Milliseconds a failed lookup is reported again without asking the resolver
+#define CONFIG_ASYNC_TCP_DNS_NEGATIVE_TTL 5000
+#endif
+
+#ifndef CONFIG_ASYNC_TCP_DNS_THREADS
+// Threads running getaddrinfo() on POSIX hosts
+#define CONFIG_ASYNC_TCP_DNS_THREADS 2
+#endif
+
+#ifndef CONFIG_ASYNC_TCP_DNS_MAX_ADDRESSES
+// Addresses of a host name kept and tried by connect(). LWIP's resolver reports one.
+#ifdef ASYNC_TCP_PLATFORM_POSIX
+#define CONFIG_ASYNC_TCP_DNS_MAX_ADDRESSES 4
+#else
+#define CONFIG_ASYNC_TCP_DNS_MAX_ADDRESSES 1
+#endif
+#endif
+
+#ifndef CONFIG_ASYNC_TCP_CONNECT_TIMEOUT
+// Milliseconds connect() may take until the connection is established, 0 for no limit
+// other than the kernel's
+#define CONFIG_ASYNC_TCP_CONNECT_TIMEOUT 30000
+#endif
+
+#ifndef CONFIG_ASYNC_TCP_CONNECT_ATTEMPT_DELAY
+// Milliseconds before connect() tries the next address of a host name while the
+// previous attempts are still pending, as recommended by RFC 8305
+#define CONFIG_ASYNC_TCP_CONNECT_ATTEMPT_DELAY 250
+#endif
+
+#ifndef CONFIG_ASYNC_TCP_POOL_MAX_IDLE
+// Idle connections a ClientPool keeps per host and port
+#define CONFIG_ASYNC_TCP_POOL_MAX_IDLE 2
+#endif
+
+#ifndef CONFIG_ASYNC_TCP_POOL_MAX_IDLE_AGE
+// Milliseconds a ClientPool keeps an idle connection. Servers commonly close them after
+// 5 to 75 seconds, which acquire() notices anyway.
+#define CONFIG_ASYNC_TCP_POOL_MAX_IDLE_AGE 10000
+#endif
+
+#ifndef CONFIG_ASYNC_TCP_USE_EPOLL
+// Readiness backend of the manager task: epoll where available, select() otherwise
+#if defined(ASYNC_TCP_PLATFORM_POSIX) && defined(__linux__)
+#define CONFIG_ASYNC_TCP_USE_EPOLL 1
+#else
+#define CONFIG_ASYNC_TCP_USE_EPOLL 0
+#endif
+#endif
+
+#ifndef CONFIG_ASYNC_TCP_WORKERS
+// Number of manager tasks. Each serves its own share of the connections, so callbacks of
+// different connections may run concurrently if this is larger than 1.
+#define CONFIG_ASYNC_TCP_WORKERS 1
+#endif
+
+#ifndef CONFIG_ASYNC_TCP_MAX_CONNECTIONS
+// Capacity of each worker's connection registry, clients and servers combined
+#ifdef CONFIG_LWIP_MAX_SOCKETS
+#define CONFIG_ASYNC_TCP_MAX_CONNECTIONS CONFIG_LWIP_MAX_SOCKETS
+#else
+#define CONFIG_ASYNC_TCP_MAX_CONNECTIONS 65536
+#endif
+#endif
+
+#ifndef CONFIG_ASYNC_TCP_LISTEN_BACKLOG
+#define CONFIG_ASYNC_TCP_LISTEN_BACKLOG 16
+#endif
+
+#ifndef CONFIG_ASYNC_TCP_ACCEPT_BUDGET
+// Connections a server accepts at most per readiness event, before other sockets get
+// their turn
+#define CONFIG_ASYNC_TCP_ACCEPT_BUDGET 16
+#endif
+
+#ifndef CONFIG_ASYNC_TCP_CLIENT_POOL_SIZE
+// Clients accepted by servers are allocated from a pool of this size, 0 disables it
+#ifdef CONFIG_LWIP_MAX_SOCKETS
+#define CONFIG_ASYNC_TCP_CLIENT_POOL_SIZE CONFIG_LWIP_MAX_SOCKETS
+#else
+#define CONFIG_ASYNC_TCP_CLIENT_POOL_SIZE 0
+#endif
+#endif
+
+#ifndef CONFIG_ASYNC_TCP_WRITE_CHUNK_POOL_SIZE
+// Segment-sized chunks kept for coalescing small copied writes, shared by all clients
+#define CONFIG_ASYNC_TCP_WRITE_CHUNK_POOL_SIZE 4
+#endif
+
+#ifndef CONFIG_ASYNC_TCP_RECV_BUFFER_SIZE
+// Size of the receive buffer shared by the clients of a worker, i.e. the most data a
+// single onData callback gets
+#ifdef CONFIG_LWIP_TCP_MSS
+#define CONFIG_ASYNC_TCP_RECV_BUFFER_SIZE CONFIG_LWIP_TCP_MSS
+#else
+#define CONFIG_ASYNC_TCP_RECV_BUFFER_SIZE 16384
+#endif
+#endif
+
+#ifndef CONFIG_ASYNC_TCP_RECV_POOL_SIZE
+// Receive buffers kept for clients with an onBuffer handler, shared by all clients
+#define CONFIG_ASYNC_TCP_RECV_POOL_SIZE 8
+#endif
+
+#ifndef CONFIG_ASYNC_TCP_READ_BUDGET
+// Bytes a client reads at most per readiness event, before other sockets get their turn
+#define CONFIG_ASYNC_TCP_READ_BUDGET (4 * CONFIG_ASYNC_TCP_RECV_BUFFER_SIZE)
+#endif
+
+#ifndef CONFIG_ASYNC_TCP_ACK_WATERMARK
+// Received bytes a client may leave unacknowledged after ackLater() before it stops
+// reading, 0 stops at once
+#define CONFIG_ASYNC_TCP_ACK_WATERMARK 0
+#endif
+
+#ifndef CONFIG_ASYNC_TCP_WRITE_QUEUE_LIMIT
+// Bytes a client queues at most on top of what the socket's send buffer takes
+#ifdef CONFIG_LWIP_TCP_SND_BUF_DEFAULT
+#define CONFIG_ASYNC_TCP_WRITE_QUEUE_LIMIT CONFIG_LWIP_TCP_SND_BUF_DEFAULT
+#else
+#define CONFIG_ASYNC_TCP_WRITE_QUEUE_LIMIT 65536
+#endif
+#endif
+
+#ifndef CONFIG_ASYNC_TCP_LOCK_FREE_WRITES
+// Whether clients start with lock-free writes, see setLockFreeWrites()
+#define CONFIG_ASYNC_TCP_LOCK_FREE_WRITES 0
+#endif
+
 #ifndef CONFIG_ASYNC_TCP_SSL_HANDSHAKE_TIMEOUT
 #define CONFIG_ASYNC_TCP_SSL_HANDSHAKE_TIMEOUT 5000
 #endif
 
-#endif
\ No newline at end of file
+#ifndef ASYNC_TCP_STATIC_CLIENT_HANDLERS
+// Handler types of StaticClient and StaticServer as a comma separated list, for example
+// -DASYNC_TCP_STATIC_CLIENT_HANDLERS=app::Echo. They are part of the manager's type, so
+// this and ASYNC_TCP_STATIC_CLIENT_HEADER, the header declaring them, must be the same
+// for every source file, those of this library included.
+#define ASYNC_TCP_STATIC_CLIENT_HANDLERS
+#endif
+
+// Last, the platform's headers need the settings above
+#if ASYNC_TCP_ENABLE_DEBUG_LOG
+#include "Platform.hpp"
+#define log_d_(...) log_d(__VA_ARGS__)
+#else
+#define log_d_(...) \
+    do {            \
+    } while (0)
+#endif
+
+#endif
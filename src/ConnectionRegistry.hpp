@@ -0,0 +1,365 @@
+#ifndef ASYNCTCPSOCK_CONNECTIONREGISTRY_HPP
+#define ASYNCTCPSOCK_CONNECTIONREGISTRY_HPP
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <utility>
+#include <variant>
+
+#include "Configuration.hpp"
+
+namespace AsyncTcpSock {
+
+/**
+ * Identifies a connection in a ConnectionRegistry. Slots are reused, but with a new
+ * generation, so a handle never refers to a different connection than the one it was
+ * created for.
+ */
+struct ConnectionHandle {
+    static constexpr std::uint32_t INVALID_SLOT =
+        std::numeric_limits<std::uint32_t>::max();
+
+    std::uint32_t slot = INVALID_SLOT;
+    std::uint32_t generation = 0;
+
+    constexpr bool isValid() const {
+        return slot != INVALID_SLOT;
+    }
+
+    constexpr std::uint64_t pack() const {
+        return (std::uint64_t(generation) << 32) | slot;
+    }
+
+    static constexpr ConnectionHandle unpack(std::uint64_t packed) {
+        return ConnectionHandle{static_cast<std::uint32_t>(packed),
+                                static_cast<std::uint32_t>(packed >> 32)};
+    }
+
+    constexpr bool operator==(const ConnectionHandle& other) const = default;
+};
+
+/**
+ * Lock-free registry of connections with O(1) add, remove and lookup, for a Variant of
+ * std::monostate and connection pointers.
+ *
+ * Slots are allocated in chunks that are never freed or moved, so readers can always
+ * access a slot. A slot's generation is odd while it is occupied and changes whenever the
+ * slot is freed or reused. Readers validate the generation before and after reading the
+ * connection, like a seqlock.
+ *
+ * Additionally, producers on any thread can signal a connection with a set of flags. The
+ * consumer collects all signaled connections at once, each of them only once regardless
+ * of how often it was signaled in between.
+ *
+ * The registry doesn't keep connections alive. A connection may only be removed by its
+ * owner, usually from its destructor, which must make sure that readers are done with
+ * it. SocketConnectionManager waits for its worker task.
+ */
+template <class Variant>
+class ConnectionRegistry {
+    static constexpr std::uint32_t CHUNK_SIZE = 32;
+    static constexpr std::uint32_t NONE = ConnectionHandle::INVALID_SLOT;
+
+    // Part of the signal word, set while the slot is on the signaled stack
+    static constexpr std::uint32_t SIGNAL_ENQUEUED = 1u << 31;
+
+    struct Slot {
+        std::atomic<std::uint32_t> generation{0};
+        std::atomic<std::uint8_t> type{0};
+        std::atomic<void*> pointer{nullptr};
+        std::atomic<std::uint32_t> nextFree{NONE};
+        // generation << 32 | SIGNAL_ENQUEUED | flags
+        std::atomic<std::uint64_t> signals{0};
+        std::atomic<std::uint32_t> nextSignaled{NONE};
+    };
+
+    struct Chunk {
+        std::array<Slot, CHUNK_SIZE> slots{};
+    };
+
+    const std::uint32_t _capacity;
+    std::unique_ptr<std::atomic<Chunk*>[]> _chunks;
+    // Number of slots ever handed out
+    std::atomic<std::uint32_t> _highWater{0};
+    // Stack of free slots, ABA tag << 32 | slot
+    std::atomic<std::uint64_t> _freeHead{NONE};
+    // Stack of signaled slots
+    std::atomic<std::uint32_t> _signaledHead{NONE};
+    std::atomic<std::size_t> _size{0};
+
+  public:
+    explicit ConnectionRegistry(std::uint32_t capacity)
+        : _capacity(capacity),
+          _chunks(std::make_unique<std::atomic<Chunk*>[]>(_chunkCount())) {
+    }
+
+    ~ConnectionRegistry() noexcept {
+        for (std::uint32_t i = 0; i < _chunkCount(); ++i) {
+            delete _chunks[i].load();
+        }
+    }
+
+    ConnectionRegistry(const ConnectionRegistry& other) = delete;
+    ConnectionRegistry(ConnectionRegistry&& other) = delete;
+
+    ConnectionRegistry& operator=(const ConnectionRegistry& other) = delete;
+    ConnectionRegistry& operator=(ConnectionRegistry&& other) = delete;
+
+    std::size_t size() const {
+        return _size.load(std::memory_order_relaxed);
+    }
+
+    /// Returns std::nullopt if the registry is full.
+    std::optional<ConnectionHandle> add(const Variant& connection) {
+        const std::optional<std::uint32_t> index = _allocate();
+        if (!index) {
+            return std::nullopt;
+        }
+
+        Slot& slot = *_slot(*index);
+        const std::uint32_t generation =
+            slot.generation.load(std::memory_order_relaxed) + 1;
+
+        // Released, so readers seeing the new data also see the generation changed
+        slot.type.store(connection.index(), std::memory_order_release);
+        slot.pointer.store(
+            std::visit(
+                [](auto&& conn) -> void* {
+                    if constexpr (std::is_pointer_v<std::decay_t<decltype(conn)>>) {
+                        return conn;
+                    } else {
+                        return nullptr;
+                    }
+                },
+                connection),
+            std::memory_order_release);
+        slot.generation.store(generation, std::memory_order_release);
+
+        _size.fetch_add(1, std::memory_order_relaxed);
+        return ConnectionHandle{*index, generation};
+    }
+
+    void remove(ConnectionHandle handle) {
+        Slot* slot = _slot(handle.slot);
+        if (slot == nullptr ||
+            slot->generation.load(std::memory_order_relaxed) != handle.generation) {
+            return;
+        }
+
+        slot->generation.store(handle.generation + 1, std::memory_order_release);
+        slot->pointer.store(nullptr, std::memory_order_release);
+
+        _size.fetch_sub(1, std::memory_order_relaxed);
+        _free(handle.slot);
+    }
+
+    /// Returns std::monostate if the connection has been removed.
+    Variant get(ConnectionHandle handle) const {
+        const Slot* slot = _slot(handle.slot);
+        if (slot == nullptr) {
+            return std::monostate{};
+        }
+
+        return _read(*slot, handle.generation);
+    }
+
+    /// Invokes fn(ConnectionHandle, Variant) for every registered connection.
+    template <class Func>
+    void forEach(Func&& fn) const {
+        const std::uint32_t highWater = _highWater.load(std::memory_order_acquire);
+        for (std::uint32_t index = 0; index < highWater; ++index) {
+            const Slot* slot = _slot(index);
+            if (slot == nullptr) {
+                // Chunk is just being allocated
+                continue;
+            }
+
+            const std::uint32_t generation =
+                slot->generation.load(std::memory_order_acquire);
+            if ((generation & 1) == 0) {
+                continue;
+            }
+
+            Variant connection = _read(*slot, generation);
+            if (connection.index() != 0) {
+                fn(ConnectionHandle{index, generation}, connection);
+            }
+        }
+    }
+
+    /// Set flags on the connection, to be collected by takeSignaled(). Ignored if the
+    /// connection has been removed. May be called from any thread.
+    void signal(ConnectionHandle handle, std::uint8_t flags) {
+        Slot* slot = _slot(handle.slot);
+        if (slot == nullptr) {
+            return;
+        }
+
+        std::uint64_t previous = slot->signals.load(std::memory_order_relaxed);
+        std::uint64_t next;
+        do {
+            if (slot->generation.load(std::memory_order_acquire) != handle.generation) {
+                return;
+            }
+
+            // Flags of a previous generation are dropped
+            const bool sameGeneration = (previous >> 32) == handle.generation;
+            const std::uint32_t previousFlags =
+                sameGeneration ? static_cast<std::uint32_t>(previous) & 0xFF : 0;
+            next = (std::uint64_t(handle.generation) << 32) |
+                   (static_cast<std::uint32_t>(previous) & SIGNAL_ENQUEUED) |
+                   SIGNAL_ENQUEUED | previousFlags | flags;
+        } while (!slot->signals.compare_exchange_weak(previous, next,
+                                                      std::memory_order_acq_rel));
+
+        if ((static_cast<std::uint32_t>(previous) & SIGNAL_ENQUEUED) == 0) {
+            std::uint32_t head = _signaledHead.load(std::memory_order_relaxed);
+            do {
+                slot->nextSignaled.store(head, std::memory_order_relaxed);
+            } while (!_signaledHead.compare_exchange_weak(head, handle.slot,
+                                                          std::memory_order_release,
+                                                          std::memory_order_relaxed));
+        }
+    }
+
+    /// Whether takeSignaled() would find any connection
+    bool hasSignaled() const {
+        return _signaledHead.load(std::memory_order_acquire) != NONE;
+    }
+
+    /// Invokes fn(ConnectionHandle, Variant, flags) for every connection signaled since
+    /// the last call and still registered. Must only be called by a single consumer.
+    template <class Func>
+    void takeSignaled(Func&& fn) {
+        std::uint32_t index = _signaledHead.exchange(NONE, std::memory_order_acquire);
+        while (index != NONE) {
+            Slot& slot = *_slot(index);
+            // Read before clearing SIGNAL_ENQUEUED, afterwards the slot may be pushed
+            // again by a producer.
+            const std::uint32_t next = slot.nextSignaled.load(std::memory_order_relaxed);
+            const std::uint64_t signals =
+                slot.signals.exchange(0, std::memory_order_acq_rel);
+
+            const ConnectionHandle handle{index,
+                                          static_cast<std::uint32_t>(signals >> 32)};
+            const std::uint8_t flags = static_cast<std::uint8_t>(signals & 0xFF);
+            Variant connection = get(handle);
+            if (flags != 0 && connection.index() != 0) {
+                fn(handle, connection, flags);
+            }
+
+            index = next;
+        }
+    }
+
+  private:
+    constexpr std::uint32_t _chunkCount() const {
+        return (_capacity + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    }
+
+    Slot* _slot(std::uint32_t index) const {
+        if (index >= _capacity) {
+            return nullptr;
+        }
+
+        Chunk* chunk = _chunks[index / CHUNK_SIZE].load(std::memory_order_acquire);
+        if (chunk == nullptr) {
+            return nullptr;
+        }
+
+        return &chunk->slots[index % CHUNK_SIZE];
+    }
+
+    Variant _read(const Slot& slot, std::uint32_t generation) const {
+        if (slot.generation.load(std::memory_order_acquire) != generation ||
+            (generation & 1) == 0) {
+            return std::monostate{};
+        }
+
+        // Acquire keeps the second check of the generation after these loads
+        const std::uint8_t type = slot.type.load(std::memory_order_acquire);
+        void* pointer = slot.pointer.load(std::memory_order_acquire);
+        if (slot.generation.load(std::memory_order_relaxed) != generation) {
+            return std::monostate{};
+        }
+
+        return _makeVariant(type, pointer,
+                            std::make_index_sequence<std::variant_size_v<Variant>>());
+    }
+
+    template <std::size_t... Index>
+    static Variant _makeVariant(std::uint8_t type,
+                                void* pointer,
+                                std::index_sequence<Index...>) {
+        Variant result;
+        (
+            [&]() {
+                using Alternative = std::variant_alternative_t<Index, Variant>;
+                if constexpr (std::is_pointer_v<Alternative>) {
+                    if (type == Index) {
+                        result.template emplace<Index>(static_cast<Alternative>(pointer));
+                    }
+                }
+            }(),
+            ...);
+        return result;
+    }
+
+    std::optional<std::uint32_t> _allocate() {
+        // Reuse a free slot
+        std::uint64_t head = _freeHead.load(std::memory_order_acquire);
+        while (static_cast<std::uint32_t>(head) != NONE) {
+            const std::uint32_t index = static_cast<std::uint32_t>(head);
+            const std::uint32_t next =
+                _slot(index)->nextFree.load(std::memory_order_relaxed);
+            const std::uint64_t newHead = (((head >> 32) + 1) << 32) | next;
+            if (_freeHead.compare_exchange_weak(head, newHead, std::memory_order_acquire,
+                                                std::memory_order_acquire)) {
+                return index;
+            }
+        }
+
+        // Or hand out a new one
+        std::uint32_t index = _highWater.load(std::memory_order_relaxed);
+        do {
+            if (index >= _capacity) {
+                return std::nullopt;
+            }
+        } while (!_highWater.compare_exchange_weak(index, index + 1,
+                                                   std::memory_order_acq_rel));
+
+        std::atomic<Chunk*>& chunk = _chunks[index / CHUNK_SIZE];
+        if (chunk.load(std::memory_order_acquire) == nullptr) {
+            Chunk* allocated = new Chunk();
+            Chunk* expected = nullptr;
+            if (!chunk.compare_exchange_strong(expected, allocated,
+                                               std::memory_order_acq_rel)) {
+                // Someone else was faster
+                delete allocated;
+            }
+        }
+
+        return index;
+    }
+
+    void _free(std::uint32_t index) {
+        Slot& slot = *_slot(index);
+        std::uint64_t head = _freeHead.load(std::memory_order_relaxed);
+        std::uint64_t newHead;
+        do {
+            slot.nextFree.store(static_cast<std::uint32_t>(head),
+                                std::memory_order_relaxed);
+            newHead = (((head >> 32) + 1) << 32) | index;
+        } while (!_freeHead.compare_exchange_weak(head, newHead,
+                                                  std::memory_order_release,
+                                                  std::memory_order_relaxed));
+    }
+};
+
+}  // namespace AsyncTcpSock
+
+#endif
@@ -0,0 +1,250 @@
+#ifndef ASYNCTCPSOCK_DNSCACHE_HPP
+#define ASYNCTCPSOCK_DNSCACHE_HPP
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Configuration.hpp"
+#include "Platform.hpp"
+
+namespace AsyncTcpSock {
+
+/// Addresses of a host name in the order connections should try them
+struct DnsAddresses {
+    static constexpr std::size_t CAPACITY = CONFIG_ASYNC_TCP_DNS_MAX_ADDRESSES;
+
+    std::array<IPAddress, CAPACITY> addresses{};
+    std::size_t count = 0;
+
+    DnsAddresses() = default;
+
+    /// Keeps the first CAPACITY of them
+    explicit DnsAddresses(std::span<const IPAddress> ips)
+        : count(std::min(ips.size(), CAPACITY)) {
+        std::copy_n(ips.begin(), count, addresses.begin());
+    }
+
+    std::span<const IPAddress> span() const {
+        return std::span(addresses.data(), count);
+    }
+};
+
+/**
+ * Results of host name lookups, shared by all clients. Addresses are reused until their
+ * TTL passes and failures until the negative TTL passes. Concurrent lookups of the same
+ * name wait for one request to the platform's resolver.
+ *
+ * Callbacks run on the resolver's thread with the cache locked, so that cancel() can
+ * make sure no callback runs for an argument afterwards. They must not call into the
+ * cache.
+ */
+class DnsCache {
+  public:
+    using Clock = std::chrono::steady_clock;
+    using Callback = void (*)(const DnsAddresses* addresses, void* arg);
+
+    static constexpr std::size_t DEFAULT_CAPACITY = CONFIG_ASYNC_TCP_DNS_CACHE_SIZE;
+    static constexpr std::chrono::milliseconds DEFAULT_TTL{
+        CONFIG_ASYNC_TCP_DNS_CACHE_TTL};
+    static constexpr std::chrono::milliseconds DEFAULT_NEGATIVE_TTL{
+        CONFIG_ASYNC_TCP_DNS_NEGATIVE_TTL};
+
+  private:
+    struct Waiter {
+        Callback callback;
+        void* arg;
+    };
+
+    struct Entry {
+        enum class State : std::uint8_t {
+            PENDING,
+            RESOLVED,
+            FAILED,
+        };
+
+        State state = State::PENDING;
+        DnsAddresses addresses{};
+        Clock::time_point expires{};
+        // Only while pending
+        std::vector<Waiter> waiters{};
+    };
+
+    std::mutex _mutex{};
+    // Pointers to entries stay valid while they are pending, the resolver holds them
+    std::unordered_map<std::string, Entry> _entries{};
+    std::size_t _capacity = DEFAULT_CAPACITY;
+    Clock::duration _ttl = DEFAULT_TTL;
+    Clock::duration _negativeTtl = DEFAULT_NEGATIVE_TTL;
+
+  public:
+    DnsCache() = default;
+
+    DnsCache(const DnsCache& other) = delete;
+    DnsCache& operator=(const DnsCache& other) = delete;
+
+    /// Never destroyed, lookups may finish during static destruction
+    static DnsCache& instance() {
+        static DnsCache* cache = new DnsCache();
+        return *cache;
+    }
+
+    /// Host names whose results are kept. Pending lookups are kept in any case.
+    void setCapacity(std::size_t capacity) {
+        std::lock_guard lock(_mutex);
+        _capacity = capacity;
+    }
+
+    /// Applies to lookups finishing afterwards
+    void setTtl(Clock::duration ttl, Clock::duration negativeTtl) {
+        std::lock_guard lock(_mutex);
+        _ttl = ttl;
+        _negativeTtl = negativeTtl;
+    }
+
+    /// Forget all finished lookups
+    void clear() {
+        std::lock_guard lock(_mutex);
+        std::erase_if(_entries, [](const auto& it) {
+            return it.second.state != Entry::State::PENDING;
+        });
+    }
+
+    /// Resolve host. Cached addresses are stored in resolved and RESOLVED is returned, a
+    /// cached failure returns FAILED. Otherwise callback(addresses, arg) is invoked once
+    /// the lookup finishes, addresses being nullptr on failure.
+    Platform::DnsStatus resolve(const char* host,
+                                DnsAddresses& resolved,
+                                Callback callback,
+                                void* arg) {
+        Entry* entry = nullptr;
+        {
+            std::lock_guard lock(_mutex);
+            const auto now = Clock::now();
+
+            auto it = _entries.find(host);
+            if (it != _entries.end()) {
+                Entry& cached = it->second;
+                if (cached.state == Entry::State::PENDING) {
+                    log_d_("Waiting for the lookup of %s in progress", host);
+                    cached.waiters.push_back(Waiter{callback, arg});
+                    return Platform::DnsStatus::IN_PROGRESS;
+                }
+                if (now < cached.expires) {
+                    if (cached.state == Entry::State::FAILED) {
+                        return Platform::DnsStatus::FAILED;
+                    }
+                    resolved = cached.addresses;
+                    return Platform::DnsStatus::RESOLVED;
+                }
+            } else {
+                _evict(now);
+                it = _entries.try_emplace(host).first;
+            }
+
+            entry = &it->second;
+            entry->state = Entry::State::PENDING;
+            entry->waiters.push_back(Waiter{callback, arg});
+        }
+
+        // Without the lock, the resolver may need a lock of its own that is held while
+        // it calls back
+        IPAddress ip;
+        const Platform::DnsStatus status =
+            Platform::resolveHost<&DnsCache::_found>(host, ip, entry);
+        if (status == Platform::DnsStatus::IN_PROGRESS) {
+            return status;
+        }
+
+        // The caller learns the result from the return value, only those that joined in
+        // the meantime are called back
+        std::lock_guard lock(_mutex);
+        const auto own = std::find_if(
+            entry->waiters.begin(), entry->waiters.end(),
+            [&](const Waiter& w) { return w.callback == callback && w.arg == arg; });
+        if (own != entry->waiters.end()) {
+            entry->waiters.erase(own);
+        }
+
+        if (status == Platform::DnsStatus::RESOLVED) {
+            resolved = DnsAddresses(std::span(&ip, 1));
+            _finish(*entry, &resolved);
+        } else {
+            // The resolver couldn't take the request, which says nothing about the name
+            _finish(*entry, nullptr);
+            _entries.erase(host);
+        }
+        return status;
+    }
+
+    /// No callback runs for arg after this returns
+    void cancel(void* arg) {
+        std::lock_guard lock(_mutex);
+        for (auto& [host, entry] : _entries) {
+            std::erase_if(entry.waiters, [&](const Waiter& w) { return w.arg == arg; });
+        }
+    }
+
+  private:
+    // Runs on the resolver's thread
+    static void _found(const IPAddress* addresses, std::size_t count, void* arg) {
+        const DnsAddresses found(std::span(addresses, addresses != nullptr ? count : 0));
+
+        DnsCache& cache = instance();
+        std::lock_guard lock(cache._mutex);
+        cache._finish(*static_cast<Entry*>(arg), found.count > 0 ? &found : nullptr);
+    }
+
+    // Assumes that _mutex is locked
+    void _finish(Entry& entry, const DnsAddresses* addresses) {
+        entry.state =
+            addresses != nullptr ? Entry::State::RESOLVED : Entry::State::FAILED;
+        entry.addresses = addresses != nullptr ? *addresses : DnsAddresses();
+        entry.expires = Clock::now() + (addresses != nullptr ? _ttl : _negativeTtl);
+
+        std::vector<Waiter> waiters = std::move(entry.waiters);
+        entry.waiters.clear();
+        for (const Waiter& waiter : waiters) {
+            waiter.callback(addresses, waiter.arg);
+        }
+    }
+
+    // Assumes that _mutex is locked. Makes room for one more entry, expired ones go
+    // first, then those expiring soonest.
+    void _evict(Clock::time_point now) {
+        if (_entries.size() < _capacity) {
+            return;
+        }
+
+        std::erase_if(_entries, [&](const auto& it) {
+            return it.second.state != Entry::State::PENDING && it.second.expires <= now;
+        });
+
+        while (_entries.size() >= _capacity) {
+            auto oldest = _entries.end();
+            for (auto it = _entries.begin(); it != _entries.end(); ++it) {
+                if (it->second.state != Entry::State::PENDING &&
+                    (oldest == _entries.end() ||
+                     it->second.expires < oldest->second.expires)) {
+                    oldest = it;
+                }
+            }
+            if (oldest == _entries.end()) {
+                // Only pending lookups, which can't be dropped
+                return;
+            }
+            _entries.erase(oldest);
+        }
+    }
+};
+
+}  // namespace AsyncTcpSock
+
+#endif
@@ -0,0 +1,216 @@
+#ifndef ASYNCTCPSOCK_EPOLLPOLLER_HPP
+#define ASYNCTCPSOCK_EPOLLPOLLER_HPP
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <span>
+#include <stdexcept>
+#include <vector>
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+#include "Configuration.hpp"
+#include "Platform.hpp"
+#include "PollEvent.hpp"
+
+namespace AsyncTcpSock {
+
+/**
+ * Readiness backend using epoll (Linux only). Sockets are registered once and the kernel
+ * is only told about changes of interest, so idle sockets cost nothing per wait().
+ * Changes of interest take effect during a wait(), only wake() needs an eventfd.
+ */
+class EpollPoller {
+    static constexpr std::size_t MAX_EVENTS = 64;
+    // Never the token of a socket, the slot of a ConnectionHandle is never all ones
+    static constexpr std::uint64_t WAKE_TOKEN = ~std::uint64_t(0);
+
+    static constexpr std::uint8_t INTEREST_NONE = 0;
+    static constexpr std::uint8_t INTEREST_READ = 0b01;
+    static constexpr std::uint8_t INTEREST_WRITE = 0b10;
+    // Distinguishes a socket registered without interest from an unregistered one
+    static constexpr std::uint8_t REGISTERED = 0b100;
+
+    int _epoll = -1;
+    int _wakeFd = -1;
+    // Set by wake() until wait() consumed the wakeup, saves writes while one is pending
+    std::atomic<bool> _wakePending = false;
+
+    struct Registration {
+        std::uint8_t interest = INTEREST_NONE;
+        std::uint64_t token = 0;
+    };
+
+    mutable std::mutex _mutex{};
+    // Indexed by socket
+    std::vector<Registration> _registrations{};
+
+    // Results of the last call to wait(), only accessed by the waiting thread
+    std::array<epoll_event, MAX_EVENTS> _events{};
+    std::array<PollEvent, MAX_EVENTS> _ready{};
+
+  public:
+    EpollPoller()
+        : _epoll(epoll_create1(EPOLL_CLOEXEC)),
+          _wakeFd(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) {
+        if (_epoll < 0 || _wakeFd < 0) {
+            log_e("epoll_create1() or eventfd() error: %d (%s)", errno, strerror(errno));
+            ::close(_epoll);
+            ::close(_wakeFd);
+            throw std::runtime_error("Failed to create epoll instance");
+        }
+
+        epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.u64 = WAKE_TOKEN;
+        if (epoll_ctl(_epoll, EPOLL_CTL_ADD, _wakeFd, &event) < 0) {
+            log_e("epoll_ctl(ADD, %d) error: %d (%s)", _wakeFd, errno, strerror(errno));
+            ::close(_epoll);
+            ::close(_wakeFd);
+            throw std::runtime_error("Failed to create epoll instance");
+        }
+    }
+
+    ~EpollPoller() noexcept {
+        ::close(_wakeFd);
+        ::close(_epoll);
+    }
+
+    EpollPoller(const EpollPoller& other) = delete;
+    EpollPoller(EpollPoller&& other) = delete;
+
+    EpollPoller& operator=(const EpollPoller& other) = delete;
+    EpollPoller& operator=(EpollPoller&& other) = delete;
+
+    /// Start watching the socket for readability. Events of the socket carry the token.
+    void add(int socket, std::uint64_t token) {
+        if (socket < 0) {
+            return;
+        }
+
+        std::lock_guard lock(_mutex);
+        if (static_cast<std::size_t>(socket) >= _registrations.size()) {
+            _registrations.resize(socket + 1);
+        }
+
+        // Always updated, a changed token must reach the kernel as well
+        _registrations[socket].token = token;
+        _update(socket, REGISTERED | INTEREST_READ, true);
+    }
+
+    /// Stop watching the socket. Must be called before it is closed, since the socket
+    /// number may be reused immediately afterwards.
+    void remove(int socket) {
+        if (socket < 0) {
+            return;
+        }
+
+        std::lock_guard lock(_mutex);
+        if (static_cast<std::size_t>(socket) >= _registrations.size() ||
+            _registrations[socket].interest == INTEREST_NONE) {
+            return;
+        }
+
+        _registrations[socket].interest = INTEREST_NONE;
+        if (epoll_ctl(_epoll, EPOLL_CTL_DEL, socket, nullptr) < 0) {
+            log_e("epoll_ctl(DEL, %d) error: %d (%s)", socket, errno, strerror(errno));
+        }
+    }
+
+    /// Change the interest of a watched socket. Unwatched sockets are ignored, so a
+    /// socket closed concurrently is never registered again by accident.
+    void setInterest(int socket, bool read, bool write) {
+        if (socket < 0) {
+            return;
+        }
+
+        std::lock_guard lock(_mutex);
+        if (static_cast<std::size_t>(socket) >= _registrations.size() ||
+            _registrations[socket].interest == INTEREST_NONE) {
+            return;
+        }
+
+        _update(socket, REGISTERED | (read ? INTEREST_READ : 0) |
+                            (write ? INTEREST_WRITE : 0));
+    }
+
+    /// Make the current or next wait() return early. Safe to call from any thread.
+    void wake() {
+        if (!_wakePending.exchange(true, std::memory_order_acq_rel)) {
+            const std::uint64_t one = 1;
+            if (::write(_wakeFd, &one, sizeof(one)) < 0 && errno != EAGAIN) {
+                log_e("write() to eventfd error: %d (%s)", errno, strerror(errno));
+            }
+        }
+    }
+
+    /// Block until any watched socket is ready, wake() is called or the timeout expires.
+    /// Returns the ready sockets, which stay valid until the next call.
+    std::span<const PollEvent> wait(std::chrono::milliseconds timeout) {
+        const int count =
+            epoll_wait(_epoll, _events.data(), _events.size(), timeout.count());
+        if (count < 0) {
+            if (errno != EINTR) {
+                log_e("epoll_wait() error: %d (%s)", errno, strerror(errno));
+            }
+            return {};
+        }
+
+        std::size_t ready = 0;
+        for (int i = 0; i < count; ++i) {
+            const epoll_event& event = _events[i];
+            if (event.data.u64 == WAKE_TOKEN) {
+                // Whatever the waker published before is visible from here on
+                std::uint64_t value;
+                [[maybe_unused]] const ssize_t result =
+                    ::read(_wakeFd, &value, sizeof(value));
+                _wakePending.store(false, std::memory_order_release);
+                continue;
+            }
+
+            // Like select(), report sockets with errors or hangups as readable and
+            // writable so the handlers discover the condition.
+            const bool failed = (event.events & (EPOLLERR | EPOLLHUP)) != 0;
+            _ready[ready++] = PollEvent{
+                .token = event.data.u64,
+                .readable = (event.events & EPOLLIN) != 0 || failed,
+                .writable = (event.events & EPOLLOUT) != 0 || failed,
+            };
+        }
+
+        return std::span(_ready.data(), ready);
+    }
+
+  private:
+    // _mutex must be locked and _registrations large enough
+    void _update(int socket, std::uint8_t interest, bool force = false) {
+        Registration& registration = _registrations[socket];
+        const std::uint8_t previous = registration.interest;
+        if (previous == interest && !force) {
+            return;
+        }
+
+        epoll_event event{};
+        event.events = ((interest & INTEREST_READ) ? std::uint32_t(EPOLLIN) : 0) |
+                       ((interest & INTEREST_WRITE) ? std::uint32_t(EPOLLOUT) : 0);
+        event.data.u64 = registration.token;
+
+        const int op = previous == INTEREST_NONE ? EPOLL_CTL_ADD : EPOLL_CTL_MOD;
+        if (epoll_ctl(_epoll, op, socket, &event) < 0) {
+            log_e("epoll_ctl(%s, %d) error: %d (%s)", op == EPOLL_CTL_ADD ? "ADD" : "MOD",
+                  socket, errno, strerror(errno));
+            return;
+        }
+
+        registration.interest = interest;
+    }
+};
+
+}  // namespace AsyncTcpSock
+
+#endif
@@ -0,0 +1,85 @@
+#ifndef ASYNCTCPSOCK_MPSCQUEUE_HPP
+#define ASYNCTCPSOCK_MPSCQUEUE_HPP
+
+#include <atomic>
+
+namespace AsyncTcpSock {
+
+struct MpscNode {
+    std::atomic<MpscNode*> next{nullptr};
+};
+
+/**
+ * Intrusive multi-producer single-consumer queue after Dmitry Vyukov, for nodes of type
+ * T deriving from MpscNode. push() is wait-free, one exchange and one store, and may be
+ * called from any thread. pop() must only be called by one thread at a time.
+ *
+ * A push() interrupted between its two steps hides the nodes after it from pop() until
+ * it completes. Producers are expected to notify the consumer after pushing.
+ */
+template <class T>
+class MpscQueue {
+    // Producers swap themselves in at the head, the consumer takes from the tail
+    std::atomic<MpscNode*> _head;
+    MpscNode* _tail;
+    MpscNode _stub{};
+
+  public:
+    MpscQueue()
+        : _head(&_stub),
+          _tail(&_stub) {
+    }
+
+    MpscQueue(const MpscQueue& other) = delete;
+    MpscQueue& operator=(const MpscQueue& other) = delete;
+
+    void push(T* node) {
+        _push(node);
+    }
+
+    /// The oldest node, or nullptr if there is none or the next one isn't linked yet
+    T* pop() {
+        MpscNode* tail = _tail;
+        MpscNode* next = tail->next.load(std::memory_order_acquire);
+
+        if (tail == &_stub) {
+            if (next == nullptr) {
+                return nullptr;
+            }
+            _tail = next;
+            tail = next;
+            next = next->next.load(std::memory_order_acquire);
+        }
+
+        if (next != nullptr) {
+            _tail = next;
+            return static_cast<T*>(tail);
+        }
+
+        if (tail != _head.load(std::memory_order_acquire)) {
+            // A producer swapped in a node but hasn't linked it yet
+            return nullptr;
+        }
+
+        // tail is the last node. Push the stub behind it, so that it can be taken.
+        _push(&_stub);
+        next = tail->next.load(std::memory_order_acquire);
+        if (next != nullptr) {
+            _tail = next;
+            return static_cast<T*>(tail);
+        }
+
+        return nullptr;
+    }
+
+  private:
+    void _push(MpscNode* node) {
+        node->next.store(nullptr, std::memory_order_relaxed);
+        MpscNode* previous = _head.exchange(node, std::memory_order_acq_rel);
+        previous->next.store(node, std::memory_order_release);
+    }
+};
+
+}  // namespace AsyncTcpSock
+
+#endif
@@ -0,0 +1,148 @@
+#ifndef ASYNCTCPSOCK_OBJECTPOOL_HPP
+#define ASYNCTCPSOCK_OBJECTPOOL_HPP
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <utility>
+
+#include "Configuration.hpp"
+#include "Platform.hpp"
+
+namespace AsyncTcpSock {
+
+/**
+ * Fixed-capacity storage for objects of type T. The storage is allocated as one block on
+ * first use and kept afterwards, so creating and destroying objects doesn't fragment the
+ * heap. Once the pool is exhausted, objects are allocated on the heap as usual.
+ *
+ * T must declare a class-specific operator new and delete, the latter calling
+ * deallocate(), so that a plain delete works for pooled objects as well.
+ */
+template <class T>
+class ObjectPool {
+    union Node {
+        Node* next;
+        alignas(T) std::byte storage[sizeof(T)];
+    };
+
+    mutable std::mutex _mutex{};
+    std::unique_ptr<Node[]> _nodes{};
+    std::size_t _capacity = 0;
+    Node* _free = nullptr;
+    std::size_t _used = 0;
+
+  public:
+    explicit ObjectPool(std::size_t capacity)
+        : _capacity(capacity) {
+    }
+
+    ObjectPool(const ObjectPool& other) = delete;
+    ObjectPool(ObjectPool&& other) = delete;
+
+    ObjectPool& operator=(const ObjectPool& other) = delete;
+    ObjectPool& operator=(ObjectPool&& other) = delete;
+
+    /// Only possible while no object is allocated from the pool. A capacity of 0
+    /// disables the pool.
+    bool setCapacity(std::size_t capacity) {
+        std::lock_guard lock(_mutex);
+        if (_used != 0) {
+            log_e("Can't resize pool with %zu objects in use", _used);
+            return false;
+        }
+
+        _nodes.reset();
+        _free = nullptr;
+        _capacity = capacity;
+        return true;
+    }
+
+    std::size_t capacity() const {
+        std::lock_guard lock(_mutex);
+        return _capacity;
+    }
+
+    std::size_t used() const {
+        std::lock_guard lock(_mutex);
+        return _used;
+    }
+
+    /// Construct an object in the pool, or on the heap if the pool is exhausted.
+    template <class... Args>
+    T* create(Args&&... args) {
+        void* storage = _allocate();
+        if (storage == nullptr) {
+            return new T(std::forward<Args>(args)...);
+        }
+
+        try {
+            // T's own operator new hides placement new
+            return ::new (storage) T(std::forward<Args>(args)...);
+        } catch (...) {
+            deallocate(storage);
+            throw;
+        }
+    }
+
+    /// Release storage of an object, which may also come from the heap.
+    void deallocate(void* ptr) {
+        if (ptr == nullptr) {
+            return;
+        }
+
+        {
+            std::lock_guard lock(_mutex);
+            if (_owns(ptr)) {
+                Node* node = static_cast<Node*>(ptr);
+                node->next = _free;
+                _free = node;
+                --_used;
+                return;
+            }
+        }
+
+        ::operator delete(ptr);
+    }
+
+  private:
+    void* _allocate() {
+        std::lock_guard lock(_mutex);
+        if (!_nodes && _capacity != 0) {
+            _nodes.reset(new (std::nothrow) Node[_capacity]);
+            if (!_nodes) {
+                log_e("Failed to allocate pool for %zu objects", _capacity);
+                _capacity = 0;
+                return nullptr;
+            }
+
+            for (std::size_t i = 0; i < _capacity; ++i) {
+                _nodes[i].next = i + 1 < _capacity ? &_nodes[i + 1] : nullptr;
+            }
+            _free = &_nodes[0];
+        }
+
+        if (_free == nullptr) {
+            return nullptr;
+        }
+
+        Node* node = _free;
+        _free = node->next;
+        ++_used;
+        return node->storage;
+    }
+
+    // _mutex must be locked
+    bool _owns(const void* ptr) const {
+        // std::less gives a total order even for pointers into different blocks
+        const Node* node = static_cast<const Node*>(ptr);
+        const std::less<const Node*> less;
+        return _nodes && !less(node, &_nodes[0]) && less(node, &_nodes[0] + _capacity);
+    }
+};
+
+}  // namespace AsyncTcpSock
+
+#endif
@@ -0,0 +1,28 @@
+#ifndef ASYNCTCPSOCK_PLATFORM_HPP
+#define ASYNCTCPSOCK_PLATFORM_HPP
+
+// Everything that differs between the ESP32 (Arduino/ESP-IDF with LWIP and FreeRTOS) and
+// a POSIX host (BSD sockets and std::thread) lives behind this header. Each backend
+// provides:
+//
+// - the log_e/log_w/log_i/log_d/log_v macros
+// - IPAddress and the LWIP error codes (err_t, ERR_*)
+// - the BSD socket API (socket, connect, select, fcntl, ...)
+// - namespace AsyncTcpSock::Platform with:
+//   - MAX_SEGMENT_SIZE, SEND_BUFFER_SIZE
+//   - TaskHandle, createTask(...), deleteTask(...), coreCount()
+//   - enterWdt(), leaveWdt(), yield()
+//   - DnsStatus, resolveHost<Callback>(...), connectFinished(...)
+//   - socketRead(...), socketPeek(...), socketWrite(...), socketWritev(...),
+//     socketSendSpace(...), socketWritable(...), acceptNonBlocking(...)
+//
+// The POSIX backend is selected by defining ASYNC_TCP_PLATFORM_POSIX, which the CMake
+// build does.
+
+#ifdef ASYNC_TCP_PLATFORM_POSIX
+#include "platform/Posix.hpp"
+#else
+#include "platform/Esp32.hpp"
+#endif
+
+#endif
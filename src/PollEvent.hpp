@@ -0,0 +1,17 @@
+#ifndef ASYNCTCPSOCK_POLLEVENT_HPP
+#define ASYNCTCPSOCK_POLLEVENT_HPP
+
+#include <cstdint>
+
+namespace AsyncTcpSock {
+
+/// A socket reported as ready by a poller, identified by the token it was added with
+struct PollEvent {
+    std::uint64_t token;
+    bool readable;
+    bool writable;
+};
+
+}  // namespace AsyncTcpSock
+
+#endif
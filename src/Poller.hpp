@@ -0,0 +1,24 @@
+#ifndef ASYNCTCPSOCK_POLLER_HPP
+#define ASYNCTCPSOCK_POLLER_HPP
+
+#include "Configuration.hpp"
+#include "PollEvent.hpp"
+
+#if CONFIG_ASYNC_TCP_USE_EPOLL
+#include "EpollPoller.hpp"
+#else
+#include "SelectPoller.hpp"
+#endif
+
+namespace AsyncTcpSock {
+
+// Readiness backend used by the SocketConnectionManager, selected at compile time
+#if CONFIG_ASYNC_TCP_USE_EPOLL
+using Poller = EpollPoller;
+#else
+using Poller = SelectPoller;
+#endif
+
+}  // namespace AsyncTcpSock
+
+#endif
@@ -0,0 +1,124 @@
+#ifndef ASYNCTCPSOCK_RECVBUFFER_HPP
+#define ASYNCTCPSOCK_RECVBUFFER_HPP
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <utility>
+
+#include "Configuration.hpp"
+#include "ObjectPool.hpp"
+
+namespace AsyncTcpSock {
+
+/// Storage for received data, taken from a pool shared by all clients. Freed once the
+/// last RecvBuffer referring to it is released.
+struct RecvBlock {
+    static constexpr std::size_t SIZE = CONFIG_ASYNC_TCP_RECV_BUFFER_SIZE;
+
+    std::atomic<std::uint32_t> references{1};
+    std::array<std::uint8_t, SIZE> bytes;
+
+    // Leaves the bytes uninitialized
+    RecvBlock() {
+    }
+
+    static ObjectPool<RecvBlock>& pool() {
+        // Never destroyed, blocks may outlive static destruction
+        static ObjectPool<RecvBlock>* pool =
+            new ObjectPool<RecvBlock>(CONFIG_ASYNC_TCP_RECV_POOL_SIZE);
+        return *pool;
+    }
+
+    static void* operator new(std::size_t size) {
+        return ::operator new(size);
+    }
+
+    static void operator delete(void* ptr) {
+        pool().deallocate(ptr);
+    }
+};
+
+/**
+ * Reference-counted view of received data. Copies and slices share the block, which goes
+ * back to the pool when the last of them is released or destroyed. Handles may be kept
+ * past the onBuffer callback and released from any thread.
+ */
+class RecvBuffer {
+    RecvBlock* _block = nullptr;
+    std::span<const std::uint8_t> _data{};
+
+  public:
+    RecvBuffer() = default;
+
+    /// Takes over the initial reference of the block, viewing its first size bytes.
+    RecvBuffer(RecvBlock* block, std::size_t size)
+        : _block(block),
+          _data(block->bytes.data(), size) {
+    }
+
+    RecvBuffer(const RecvBuffer& other)
+        : _block(other._block),
+          _data(other._data) {
+        if (_block) {
+            _block->references.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    RecvBuffer(RecvBuffer&& other) noexcept
+        : _block(std::exchange(other._block, nullptr)),
+          _data(std::exchange(other._data, {})) {
+    }
+
+    RecvBuffer& operator=(RecvBuffer other) noexcept {
+        std::swap(_block, other._block);
+        std::swap(_data, other._data);
+        return *this;
+    }
+
+    ~RecvBuffer() {
+        release();
+    }
+
+    const std::uint8_t* data() const {
+        return _data.data();
+    }
+
+    std::size_t size() const {
+        return _data.size();
+    }
+
+    bool empty() const {
+        return _data.empty();
+    }
+
+    std::span<const std::uint8_t> span() const {
+        return _data;
+    }
+
+    /// Another handle to part of the data, clamped to the available bytes.
+    RecvBuffer slice(std::size_t offset, std::size_t length = SIZE_MAX) const {
+        RecvBuffer result(*this);
+        offset = std::min(offset, _data.size());
+        result._data = _data.subspan(offset, std::min(length, _data.size() - offset));
+        return result;
+    }
+
+    /// Drops this handle's reference, leaving it empty.
+    void release() {
+        RecvBlock* block = std::exchange(_block, nullptr);
+        _data = {};
+
+        // acq_rel so that all uses of the data happen before the block is reused
+        if (block && block->references.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            delete block;
+        }
+    }
+};
+
+}  // namespace AsyncTcpSock
+
+#endif
@@ -0,0 +1,223 @@
+#ifndef ASYNCTCPSOCK_RINGBUFFER_HPP
+#define ASYNCTCPSOCK_RINGBUFFER_HPP
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <span>
+#include <utility>
+
+namespace AsyncTcpSock {
+
+/**
+ * Growable FIFO queue in a ring of slots, with O(1) push_back() and pop_front(). The
+ * capacity is a power of two and doubles when the ring is full, it never shrinks.
+ *
+ * Elements are constructed in place on push and destroyed on pop, so unused slots cost
+ * nothing but their storage.
+ */
+template <class T>
+class RingBuffer {
+    struct alignas(T) Slot {
+        std::byte bytes[sizeof(T)];
+    };
+
+    std::unique_ptr<Slot[]> _slots;
+    std::size_t _capacity;
+    std::size_t _head = 0;
+    std::size_t _size = 0;
+
+  public:
+    explicit RingBuffer(std::size_t initialCapacity = 8)
+        : _capacity(std::bit_ceil(std::max<std::size_t>(initialCapacity, 1))) {
+        _slots = std::make_unique_for_overwrite<Slot[]>(_capacity);
+    }
+
+    RingBuffer(const RingBuffer& other) = delete;
+    RingBuffer(RingBuffer&& other) = delete;
+
+    RingBuffer& operator=(const RingBuffer& other) = delete;
+    RingBuffer& operator=(RingBuffer&& other) = delete;
+
+    ~RingBuffer() {
+        clear();
+    }
+
+    bool empty() const {
+        return _size == 0;
+    }
+
+    std::size_t size() const {
+        return _size;
+    }
+
+    std::size_t capacity() const {
+        return _capacity;
+    }
+
+    T& operator[](std::size_t index) {
+        return *_at(_slot(index));
+    }
+
+    const T& operator[](std::size_t index) const {
+        return *_at(_slot(index));
+    }
+
+    T& front() {
+        return (*this)[0];
+    }
+
+    const T& front() const {
+        return (*this)[0];
+    }
+
+    T& back() {
+        return (*this)[_size - 1];
+    }
+
+    const T& back() const {
+        return (*this)[_size - 1];
+    }
+
+    template <class... Args>
+    T& emplace_back(Args&&... args) {
+        if (_size == _capacity) {
+            _grow();
+        }
+
+        T* element =
+            ::new (_slots[_slot(_size)].bytes) T(std::forward<Args>(args)...);
+        ++_size;
+        return *element;
+    }
+
+    void push_back(T&& value) {
+        emplace_back(std::move(value));
+    }
+
+    void pop_front() {
+        std::destroy_at(_at(_head));
+        _head = _slot(1);
+        --_size;
+    }
+
+    void clear() {
+        while (!empty()) {
+            pop_front();
+        }
+        _head = 0;
+    }
+
+  private:
+    std::size_t _slot(std::size_t index) const {
+        return (_head + index) & (_capacity - 1);
+    }
+
+    T* _at(std::size_t slot) const {
+        return std::launder(reinterpret_cast<T*>(_slots[slot].bytes));
+    }
+
+    void _grow() {
+        auto slots = std::make_unique_for_overwrite<Slot[]>(_capacity * 2);
+        for (std::size_t i = 0; i < _size; ++i) {
+            T* element = _at(_slot(i));
+            ::new (slots[i].bytes) T(std::move(*element));
+            std::destroy_at(element);
+        }
+
+        _slots = std::move(slots);
+        _capacity *= 2;
+        _head = 0;
+    }
+};
+
+/**
+ * Bounded FIFO queue of bytes. The free space is filled in place through writable() and
+ * commit(), the stored bytes are copied out with peek() and read().
+ */
+class ByteRing {
+    std::unique_ptr<std::uint8_t[]> _bytes{};
+    std::size_t _capacity = 0;
+    std::size_t _head = 0;
+    std::size_t _size = 0;
+
+  public:
+    ByteRing() = default;
+
+    explicit ByteRing(std::size_t capacity)
+        : _bytes(std::make_unique_for_overwrite<std::uint8_t[]>(capacity)),
+          _capacity(capacity) {
+    }
+
+    bool empty() const {
+        return _size == 0;
+    }
+
+    std::size_t size() const {
+        return _size;
+    }
+
+    std::size_t capacity() const {
+        return _capacity;
+    }
+
+    /// The contiguous free space behind the stored bytes, empty if the ring is full.
+    std::span<std::uint8_t> writable() {
+        // Start over at the beginning to keep the free space in one piece. Not done in
+        // skip(), which may run while the space handed out here is being filled.
+        if (_size == 0) {
+            _head = 0;
+        }
+
+        std::size_t tail = _head + _size;
+        if (tail >= _capacity) {
+            tail -= _capacity;
+        }
+
+        // The free space either ends at the stored bytes or at the end of the storage
+        const std::size_t end = tail < _head || _size == _capacity ? _head : _capacity;
+        return {_bytes.get() + tail, end - tail};
+    }
+
+    /// Append size bytes that were written to writable().
+    void commit(std::size_t size) {
+        _size += size;
+    }
+
+    /// Copy the oldest bytes without removing them. Returns the number of bytes copied.
+    std::size_t peek(std::span<std::uint8_t> out) const {
+        const std::size_t size = std::min(out.size(), _size);
+        const std::size_t first = std::min(size, _capacity - _head);
+        std::copy_n(_bytes.get() + _head, first, out.begin());
+        std::copy_n(_bytes.get(), size - first, out.begin() + first);
+        return size;
+    }
+
+    /// Copy and remove the oldest bytes. Returns the number of bytes read.
+    std::size_t read(std::span<std::uint8_t> out) {
+        const std::size_t size = peek(out);
+        skip(size);
+        return size;
+    }
+
+    void skip(std::size_t size) {
+        size = std::min(size, _size);
+        _head += size;
+        if (_head >= _capacity) {
+            _head -= _capacity;
+        }
+        _size -= size;
+    }
+
+    void clear() {
+        _head = 0;
+        _size = 0;
+    }
+};
+
+}  // namespace AsyncTcpSock
+
+#endif
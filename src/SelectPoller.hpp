@@ -0,0 +1,248 @@
+#ifndef ASYNCTCPSOCK_SELECTPOLLER_HPP
+#define ASYNCTCPSOCK_SELECTPOLLER_HPP
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <span>
+#include <stdexcept>
+#include <vector>
+
+#include "Configuration.hpp"
+#include "Platform.hpp"
+#include "PollEvent.hpp"
+
+namespace AsyncTcpSock {
+
+/**
+ * Readiness backend using select(). The interest sets persist between calls to wait() and
+ * are only copied, not rebuilt, for each call. Limited to FD_SETSIZE sockets, which is
+ * not a concern with LWIP.
+ *
+ * select() doesn't see changes made while it waits, so wake() and changes of interest
+ * during a wait() send a datagram to a UDP socket connected to itself. This works with
+ * LWIP as well, which has neither pipes nor eventfds on every version.
+ */
+class SelectPoller {
+    mutable std::mutex _mutex{};
+    int _wakeSocket = -1;
+    // Set by wake() until wait() consumed the wakeup, saves sends while one is pending
+    std::atomic<bool> _wakePending = false;
+    // Whether a wait() is in progress with the interest sets copied
+    bool _waiting = false;
+    fd_set _registered{};
+    fd_set _interestRead{};
+    fd_set _interestWrite{};
+    int _maxSocket = -1;
+    // Indexed by socket
+    std::array<std::uint64_t, FD_SETSIZE> _tokens{};
+
+    // Results of the last call to wait(), only accessed by the waiting thread
+    fd_set _readyRead{};
+    fd_set _readyWrite{};
+    std::vector<PollEvent> _ready{};
+
+  public:
+    SelectPoller() {
+        FD_ZERO(&_registered);
+        FD_ZERO(&_interestRead);
+        FD_ZERO(&_interestWrite);
+        FD_ZERO(&_readyRead);
+        FD_ZERO(&_readyWrite);
+
+        _wakeSocket = _openWakeSocket();
+        if (_wakeSocket < 0 || _wakeSocket >= FD_SETSIZE) {
+            log_e("Failed to open the wakeup socket: %d (%s)", errno, strerror(errno));
+            ::close(_wakeSocket);
+            throw std::runtime_error("Failed to create select() poller");
+        }
+        _update(_wakeSocket, true, false);
+    }
+
+    ~SelectPoller() noexcept {
+        ::close(_wakeSocket);
+    }
+
+    SelectPoller(const SelectPoller& other) = delete;
+    SelectPoller(SelectPoller&& other) = delete;
+
+    SelectPoller& operator=(const SelectPoller& other) = delete;
+    SelectPoller& operator=(SelectPoller&& other) = delete;
+
+    /// Start watching the socket for readability. Events of the socket carry the token.
+    void add(int socket, std::uint64_t token) {
+        if (socket < 0) {
+            return;
+        } else if (socket >= FD_SETSIZE) {
+            log_e("socket %d exceeds FD_SETSIZE and can't be watched", socket);
+            return;
+        }
+
+        std::lock_guard lock(_mutex);
+        FD_SET(socket, &_registered);
+        _tokens[socket] = token;
+        _update(socket, true, false);
+        _wakeIfWaiting();
+    }
+
+    /// Stop watching the socket. Must be called before it is closed.
+    void remove(int socket) {
+        if (socket < 0 || socket >= FD_SETSIZE) {
+            return;
+        }
+
+        std::lock_guard lock(_mutex);
+        FD_CLR(socket, &_registered);
+        _update(socket, false, false);
+    }
+
+    /// Change the interest of a watched socket. Unwatched sockets are ignored, so a
+    /// socket closed concurrently is never registered again by accident.
+    void setInterest(int socket, bool read, bool write) {
+        if (socket < 0 || socket >= FD_SETSIZE) {
+            return;
+        }
+
+        std::lock_guard lock(_mutex);
+        if (FD_ISSET(socket, &_registered) && _update(socket, read, write)) {
+            _wakeIfWaiting();
+        }
+    }
+
+    /// Make the current or next wait() return early. Safe to call from any thread.
+    void wake() {
+        if (!_wakePending.exchange(true, std::memory_order_acq_rel)) {
+            const std::uint8_t byte = 0;
+            if (::send(_wakeSocket, &byte, sizeof(byte), 0) < 0 && errno != EAGAIN &&
+                errno != EWOULDBLOCK) {
+                log_e("send() to wakeup socket error: %d (%s)", errno, strerror(errno));
+            }
+        }
+    }
+
+    /// Block until any watched socket is ready, wake() is called or the timeout expires.
+    /// Returns the ready sockets, which stay valid until the next call.
+    std::span<const PollEvent> wait(std::chrono::milliseconds timeout) {
+        int maxSocket;
+        {
+            std::lock_guard lock(_mutex);
+            std::memcpy(&_readyRead, &_interestRead, sizeof(fd_set));
+            std::memcpy(&_readyWrite, &_interestWrite, sizeof(fd_set));
+            maxSocket = _maxSocket;
+            _waiting = true;
+        }
+
+        timeval tv{};
+        tv.tv_sec = timeout.count() / 1000;
+        tv.tv_usec = (timeout.count() % 1000) * 1000;
+
+        _ready.clear();
+
+        int result = select(maxSocket + 1, &_readyRead, &_readyWrite, nullptr, &tv);
+
+        std::lock_guard lock(_mutex);
+        _waiting = false;
+        if (result < 0) {
+            if (errno != EINTR) {
+                log_e("select() error: %d (%s)", errno, strerror(errno));
+            }
+            return {};
+        }
+
+        if (FD_ISSET(_wakeSocket, &_readyRead)) {
+            // Whatever the waker published before is visible from here on
+            std::uint8_t byte;
+            while (::recv(_wakeSocket, &byte, sizeof(byte), 0) > 0) {
+            }
+            _wakePending.store(false, std::memory_order_release);
+            FD_CLR(_wakeSocket, &_readyRead);
+            --result;
+        }
+
+        // Sockets removed in the meantime are dropped
+        for (int socket = 0; socket <= maxSocket && _ready.size() < std::size_t(result);
+             ++socket) {
+            const bool readable = FD_ISSET(socket, &_readyRead);
+            const bool writable = FD_ISSET(socket, &_readyWrite);
+            if ((readable || writable) && FD_ISSET(socket, &_registered)) {
+                _ready.push_back(PollEvent{.token = _tokens[socket],
+                                           .readable = readable,
+                                           .writable = writable});
+            }
+        }
+
+        return _ready;
+    }
+
+  private:
+    static int _openWakeSocket() {
+        const int wakeSocket = ::socket(AF_INET, SOCK_DGRAM, 0);
+        if (wakeSocket < 0) {
+            return -1;
+        }
+
+        // Bound to an ephemeral loopback port and connected to itself
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        address.sin_port = 0;
+        socklen_t addressSize = sizeof(address);
+        if (::bind(wakeSocket, reinterpret_cast<sockaddr*>(&address), addressSize) < 0 ||
+            ::getsockname(wakeSocket, reinterpret_cast<sockaddr*>(&address),
+                          &addressSize) < 0 ||
+            ::connect(wakeSocket, reinterpret_cast<sockaddr*>(&address), addressSize) <
+                0 ||
+            fcntl(wakeSocket, F_SETFL, fcntl(wakeSocket, F_GETFL, 0) | O_NONBLOCK) < 0) {
+            const int error = errno;
+            ::close(wakeSocket);
+            errno = error;
+            return -1;
+        }
+
+        return wakeSocket;
+    }
+
+    // _mutex must be locked
+    void _wakeIfWaiting() {
+        if (_waiting) {
+            wake();
+        }
+    }
+
+    // _mutex must be locked. Returns whether the interest changed.
+    bool _update(int socket, bool read, bool write) {
+        const bool changed = (FD_ISSET(socket, &_interestRead) != 0) != read ||
+                             (FD_ISSET(socket, &_interestWrite) != 0) != write;
+
+        if (read) {
+            FD_SET(socket, &_interestRead);
+        } else {
+            FD_CLR(socket, &_interestRead);
+        }
+
+        if (write) {
+            FD_SET(socket, &_interestWrite);
+        } else {
+            FD_CLR(socket, &_interestWrite);
+        }
+
+        if (read || write) {
+            _maxSocket = std::max(_maxSocket, socket);
+        } else if (socket == _maxSocket) {
+            while (_maxSocket >= 0 && !FD_ISSET(_maxSocket, &_interestRead) &&
+                   !FD_ISSET(_maxSocket, &_interestWrite)) {
+                --_maxSocket;
+            }
+        }
+
+        return changed;
+    }
+};
+
+}  // namespace AsyncTcpSock
+
+#endif
@@ -2,27 +2,15 @@
 #define ASYNCTCPSOCK_SERVER_HPP
 
 #include "Client.hpp"
-#include "SocketConnection.hpp"
+#include "ServerBase.hpp"
 
 namespace AsyncTcpSock {
 
-class Server : public SocketConnection {
-  public:
-    using ClientType = Client;
-    using Callbacks = ServerCallbacks<Server>;
-
-    static constexpr bool IS_SERVER = true;
-    static constexpr int BACKLOG = 5;
-
-  private:
-    IPAddress _addr{IP_ADDR_ANY};
-    std::uint16_t _port = 0;
-
-    bool _noDelay = true;  // Whether new connections will use TCP_NODELAY
-    Callbacks _callbacks{this};
-
+class Server : public ServerBase<Server, Client> {
   public:
     Server(std::uint16_t port);
+    /// An IPv6 address listens for IPv6 connections, the IPv6 any address (::) for those
+    /// of both families
     Server(IPAddress addr, std::uint16_t port);
 
     ~Server() noexcept override;
@@ -32,18 +20,8 @@ class Server : public SocketConnection {
 
     Server& operator=(const Server& other) = delete;
     Server& operator=(Server&& other) = delete;
-
-    void begin();
-    void end();
-
-    void onClient(Callbacks::AcceptHandler cb, void* arg = nullptr);
-    // Disable Nagle's algorithm on new connections
-    void setNoDelay(bool noDelay);
-
-    // Required by ManagedServer concept
-    void _sockIsReadable();
 };
 
 }  // namespace AsyncTcpSock
 
-#endif
\ No newline at end of file
+#endif
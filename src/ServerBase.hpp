@@ -0,0 +1,65 @@
+#ifndef ASYNCTCPSOCK_SERVERBASE_HPP
+#define ASYNCTCPSOCK_SERVERBASE_HPP
+
+#include <cstddef>
+
+#include "Callbacks.hpp"
+#include "Configuration.hpp"
+#include "SocketConnection.hpp"
+
+namespace AsyncTcpSock {
+
+/// Accepts connections into clients of type Client, which must provide pool() like
+/// Client does.
+template <class Server, class Client>
+class ServerBase : public SocketConnection {
+  public:
+    using ClientType = Client;
+    using Callbacks = ServerCallbacks<Server, Client>;
+
+    static constexpr bool IS_SERVER = true;
+    static constexpr int DEFAULT_BACKLOG = CONFIG_ASYNC_TCP_LISTEN_BACKLOG;
+    static constexpr std::size_t DEFAULT_ACCEPT_BUDGET = CONFIG_ASYNC_TCP_ACCEPT_BUDGET;
+
+  private:
+    IPAddress _addr{};  // 0.0.0.0, i.e. any address
+    std::uint16_t _port = 0;
+
+    bool _noDelay = true;  // Whether new connections will use TCP_NODELAY
+    int _backlog = DEFAULT_BACKLOG;
+    std::size_t _acceptBudget = DEFAULT_ACCEPT_BUDGET;
+    Callbacks _callbacks{static_cast<Server*>(this)};
+
+  public:
+    ServerBase(std::uint16_t port);
+    /// An IPv6 address listens for IPv6 connections, the IPv6 any address (::) for those
+    /// of both families
+    ServerBase(IPAddress addr, std::uint16_t port);
+
+    ServerBase(const ServerBase& other) = delete;
+    ServerBase(ServerBase&& other) = delete;
+
+    ServerBase& operator=(const ServerBase& other) = delete;
+    ServerBase& operator=(ServerBase&& other) = delete;
+
+    void begin();
+    void end();
+
+    void onClient(Callbacks::AcceptHandler cb, void* arg = nullptr);
+    // Disable Nagle's algorithm on new connections
+    void setNoDelay(bool noDelay);
+    // Length of the queue of pending connections. Applies immediately if the server is
+    // running.
+    void setBacklog(int backlog);
+    // Connections accepted at most per readiness event, at least 1
+    void setAcceptBudget(std::size_t budget);
+
+    // Required by ManagedServer concept
+    void _sockIsReadable();
+};
+
+}  // namespace AsyncTcpSock
+
+#include "ServerBase.tpp"
+
+#endif
@@ -0,0 +1,159 @@
+#ifndef ASYNCTCPSOCK_SERVERBASE_TPP
+#define ASYNCTCPSOCK_SERVERBASE_TPP
+
+#include "ServerBase.hpp"
+
+//
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include "Callbacks.hpp"
+#include "Platform.hpp"
+
+namespace AsyncTcpSock {
+
+template <class Server, class Client>
+ServerBase<Server, Client>::ServerBase(std::uint16_t port)
+    : SocketConnection(), _port(port) {
+    log_d_("Server created on port %d", port);
+}
+
+template <class Server, class Client>
+ServerBase<Server, Client>::ServerBase(IPAddress addr, std::uint16_t port)
+    : SocketConnection(), _addr(addr), _port(port) {
+    log_d_("Server created on %s:%d", addr.toString().c_str(), port);
+}
+
+template <class Server, class Client>
+void ServerBase<Server, Client>::begin() {
+    if (isOpen())
+        return;
+
+    sockaddr_storage server;
+    const socklen_t serverSize = _socketAddress(_addr, _port, server);
+
+    errno = 0;
+    int socket = ::socket(server.ss_family, SOCK_STREAM, 0);
+    if (socket < 0) {
+        log_e("socket() error: %d (%s)", errno, strerror(errno));
+        return;
+    }
+
+    if (server.ss_family == AF_INET6 && !_addr) {
+        // The IPv6 any address also accepts IPv4 connections, as IPv4-mapped addresses
+        const int v6Only = 0;
+        if (setsockopt(socket, IPPROTO_IPV6, IPV6_V6ONLY, &v6Only, sizeof(v6Only)) < 0) {
+            log_w("dual-stack listening unavailable: %d (%s)", errno, strerror(errno));
+        }
+    }
+
+    int res = ::bind(socket, reinterpret_cast<sockaddr*>(&server), serverSize);
+    if (res < 0) {
+        log_e("bind() error: %d (%s)", errno, strerror(errno));
+        ::close(socket);
+        return;
+    }
+
+    res = ::listen(socket, _backlog);
+    if (res < 0) {
+        log_e("listen() error: %d (%s)", errno, strerror(errno));
+        ::close(socket);
+        return;
+    }
+
+    _configureSocket(socket);
+    watch(static_cast<Server*>(this), socket);
+
+    log_d_("Server acquired socket %d, listening on %s:%d", socket,
+           _addr.toString().c_str(), _port);
+}
+
+template <class Server, class Client>
+void ServerBase<Server, Client>::end() {
+    if (!isOpen()) {
+        return;
+    }
+
+    const int socket = _socket.exchange(-1);
+    unwatch(static_cast<Server*>(this), socket);
+    ::close(socket);
+
+    log_d_("Server socket closed");
+}
+
+template <class Server, class Client>
+void ServerBase<Server, Client>::onClient(Callbacks::AcceptHandler cb, void* arg) {
+    _callbacks.acceptHandler = cb;
+    _callbacks.acceptArg = arg;
+}
+
+template <class Server, class Client>
+void ServerBase<Server, Client>::setNoDelay(bool noDelay) {
+    _noDelay = noDelay;
+}
+
+template <class Server, class Client>
+void ServerBase<Server, Client>::setBacklog(int backlog) {
+    _backlog = backlog;
+
+    // Listening again only updates the backlog, with BSD sockets as well as LWIP
+    const int socket = _socket;
+    if (socket != -1 && ::listen(socket, _backlog) < 0) {
+        log_e("listen() error: %d (%s)", errno, strerror(errno));
+    }
+}
+
+template <class Server, class Client>
+void ServerBase<Server, Client>::setAcceptBudget(std::size_t budget) {
+    _acceptBudget = std::max<std::size_t>(budget, 1);
+}
+
+template <class Server, class Client>
+void ServerBase<Server, Client>::_sockIsReadable() {
+    if (!detail::isSet(_callbacks.acceptHandler)) {
+        return;
+    }
+
+    // Drain the queue of pending connections, within the budget. Whatever is left is
+    // reported as readable again by the next wait.
+    for (std::size_t i = 0; i < _acceptBudget; ++i) {
+        sockaddr_storage clientInfo{};
+        socklen_t clientSize = sizeof(clientInfo);
+        errno = 0;
+        int acceptedSocket = Platform::acceptNonBlocking(
+            _socket, reinterpret_cast<sockaddr*>(&clientInfo), &clientSize);
+
+        if (acceptedSocket < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                // The next pending connection may be fine
+                continue;
+            } else if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                log_e("accept() error: %d (%s)", errno, strerror(errno));
+            }
+            return;
+        }
+
+        // Raw allocation... Not nice but required for API compatibility. The client is
+        // still freed with delete, which returns it to the pool.
+        ClientType* client = ClientType::pool().create(NonBlockingSocket{acceptedSocket});
+        if (!client) {
+            log_e("Failed to allocate Client object for new connection");
+            ::close(acceptedSocket);
+            return;
+        }
+
+        client->setNoDelay(_noDelay);
+        _callbacks.template invoke<ServerCallbackType::ACCEPT>(client);
+
+        if (!isOpen()) {
+            // Closed by the callback
+            return;
+        }
+    }
+}
+
+}  // namespace AsyncTcpSock
+
+#endif
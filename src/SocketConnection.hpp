@@ -1,31 +1,57 @@
 #ifndef ASYNCTCPSOCK_SOCKETCONNECTION_HPP
 #define ASYNCTCPSOCK_SOCKETCONNECTION_HPP
 
+#include <array>
 #include <atomic>
 #include <chrono>
 #include <concepts>
 #include <cstdint>
-#include <mutex>
+#include <optional>
+#include <span>
 #include <string_view>
 #include <variant>
 #include <vector>
 
-#include <esp32-hal-log.h>
-#include <esp32-hal.h>
-#include <freertos/idf_additions.h>
-#include <portmacro.h>
-
 #include "Configuration.hpp"
+#include "ConnectionRegistry.hpp"
+#include "Platform.hpp"
+#include "Poller.hpp"
+#include "TimerWheel.hpp"
 
 namespace AsyncTcpSock {
 
 // Forward declaration used by clients and servers to register/unregister themselves with
 // the manager instance. The project must contain an explicit specialization somewhere for
-// each class to be managed.
+// each class to be managed, or an overload like those of StaticClient in AsyncTCP.h.
 template <class Connection>
 void manage(Connection* conn);
 template <class Connection>
 void unmanage(Connection* conn);
+// Same as above, used to (un)register the socket of a managed connection for readiness
+// notifications. watch() is called after a new socket has been opened, unwatch() right
+// before it is closed.
+template <class Connection>
+void watch(Connection* conn, int socket);
+template <class Connection>
+void unwatch(Connection* conn, int socket);
+// Called by connections whenever their read or write interest changes
+template <class Connection>
+void updateInterest(Connection* conn, int socket, bool read, bool write);
+// Called by clients once DNS resolution finished, possibly from another thread
+template <class Connection>
+void signalDnsFinished(Connection* conn);
+// Called by clients whose next deadline may have moved earlier, possibly from another
+// thread
+template <class Connection>
+void signalTimersChanged(Connection* conn);
+// Called by clients in lock-free write mode once writes were submitted, possibly from
+// another thread
+template <class Connection>
+void signalSubmitted(Connection* conn);
+// Called by clients to be released once their callbacks have returned, possibly from
+// another thread
+template <class Connection>
+void signalReleased(Connection* conn);
 
 template <class Impl>
 concept ManagedConnection = requires(Impl impl) {
@@ -33,6 +59,11 @@ concept ManagedConnection = requires(Impl impl) {
     { impl.getSocket() } -> std::same_as<int>;
     { impl.isDnsFinished() } -> std::same_as<bool>;
     { impl.setDnsFinished(bool{}) } -> std::same_as<void>;
+    // Registration with the manager
+    { impl.getHandle() } -> std::same_as<ConnectionHandle>;
+    { impl.setHandle(ConnectionHandle{}) } -> std::same_as<void>;
+    { impl.getShard() } -> std::same_as<std::size_t>;
+    { impl.setShard(std::size_t{}) } -> std::same_as<void>;
     { impl.getLastActive() } -> std::same_as<std::chrono::steady_clock::time_point>;
     { impl.setLastActive(std::chrono::steady_clock::time_point{}) } -> std::same_as<void>;
     { impl.setLastActive() } -> std::same_as<void>;
@@ -43,17 +74,25 @@ concept ManagedClient = ManagedConnection<Impl> && requires(Impl impl) {
     requires !Impl::IS_SERVER;
     // Action to take on a writable socket
     { impl._sockIsWriteable() } -> std::same_as<bool>;
-    // Action to take on a readable socket
-    { impl._sockIsReadable() } -> std::same_as<void>;
+    // Action to take on a readable socket. Data the client has no storage for is read
+    // into the worker's scratch buffer.
+    { impl._sockIsReadable(std::span<std::uint8_t>{}) } -> std::same_as<void>;
     // Action to take when DNS-resolution is finished
     { impl._sockDelayedConnect() } -> std::same_as<void>;
-    // Action to take for an idle socket when the polling timer runs out
+    // Earliest time _sockPoll() has something to do, time_point::max() for never
+    { impl._nextDeadline() } -> std::same_as<std::chrono::steady_clock::time_point>;
+    // Action to take once the deadline has passed
     { impl._sockPoll() } -> std::same_as<void>;
+    // Action to take when writes were submitted from other threads
+    { impl._sockSubmitted() } -> std::same_as<void>;
+    // Action to take when the client is to be released, outside of its callbacks
+    { impl._sockReleased() } -> std::same_as<void>;
+    // Tick of the manager's timer entry for the client
+    { impl.getTimerTick() } -> std::same_as<std::uint64_t>;
+    { impl.setTimerTick(std::uint64_t{}) } -> std::same_as<void>;
     // Action to take when processing is done for this socket in the manager task. Do
     // cleanup here.
     { impl._processingDone() } -> std::same_as<void>;
-    // Test if there is data pending to be written
-    { impl._pendingWrite() } -> std::same_as<bool>;
 };
 
 template <class Impl>
@@ -93,6 +132,31 @@ concept ClientVariantType = detail::isVariantOfClientPointers<Variant>::value;
 template <class Variant>
 concept ServerVariantType = detail::isVariantOfServerPointers<Variant>::value;
 
+namespace detail {
+template <class ClientVariant, class ServerVariant>
+struct ConnectionVariantOf;
+
+template <class... Clients, class... Servers>
+struct ConnectionVariantOf<std::variant<Clients...>, std::variant<Servers...>> {
+    using type = std::variant<std::monostate, Clients..., Servers...>;
+};
+}  // namespace detail
+
+/// A socket that is already non-blocking, e.g. from Platform::acceptNonBlocking()
+struct NonBlockingSocket {
+    int socket;
+};
+
+/// How the manager assigns new connections to its workers
+enum class ShardPolicy : std::uint8_t {
+    ROUND_ROBIN,
+    // The worker with the fewest connections
+    LEAST_LOADED,
+    // Hash of the peer address, so connections from one host share a worker. Falls back
+    // to round-robin for connections without a peer yet.
+    REMOTE_ADDRESS_HASH,
+};
+
 /**
  * Formerly AsyncSocketBase
  *
@@ -104,11 +168,18 @@ struct SocketConnection {
   protected:
     std::atomic<int> _socket = -1;
     std::atomic<bool> _dnsFinished = false;
+    // Set by the manager while the connection is managed, packed so that other threads
+    // never see a torn handle
+    std::atomic<std::uint64_t> _handle = ConnectionHandle{}.pack();
+    std::uint8_t _shard = 0;
     std::chrono::steady_clock::time_point _lastActive = std::chrono::steady_clock::now();
+    // Only used by the worker task of the shard
+    std::uint64_t _timerTick = TimerWheel<ConnectionHandle>::NO_TICK;
 
   public:
     SocketConnection();
     SocketConnection(int socket);
+    SocketConnection(NonBlockingSocket socket);
 
     virtual ~SocketConnection() noexcept = default;
 
@@ -124,101 +195,287 @@ struct SocketConnection {
     bool isDnsFinished() const;
     void setDnsFinished(bool finished);
 
+    ConnectionHandle getHandle() const;
+    void setHandle(ConnectionHandle handle);
+
+    std::size_t getShard() const;
+    void setShard(std::size_t shard);
+
     std::chrono::steady_clock::time_point getLastActive() const;
     void setLastActive(
         std::chrono::steady_clock::time_point when = std::chrono::steady_clock::now());
 
+    std::uint64_t getTimerTick() const;
+    void setTimerTick(std::uint64_t tick);
+
   protected:
     void _configureSocket(int socket);
+    // Fills addr for connecting or binding to ip and port, returns the size used
+    static socklen_t _socketAddress(const IPAddress& ip,
+                                    std::uint16_t port,
+                                    sockaddr_storage& addr);
 };
 
+/**
+ * Runs CONFIG_ASYNC_TCP_WORKERS worker tasks, called shards. Each shard has its own
+ * connections, poller and work list, so shards never contend with each other. A
+ * connection is assigned to a shard once, when it is added, according to the
+ * ShardPolicy. This includes clients accepted by a Server, which therefore don't
+ * necessarily share the server's shard.
+ *
+ * Removing a connection from any other thread than its worker task waits until the task
+ * no longer uses it, so the connection can be destroyed right afterwards. Therefore,
+ * connections mustn't be removed while holding a lock their callbacks take, and the
+ * callbacks of one shard mustn't delete connections of another shard whose callbacks may
+ * do the same in turn. Use releaseLater() for those instead.
+ */
 template <ClientVariantType ClientVariant, ServerVariantType ServerVariant>
 class SocketConnectionManager {
     static constexpr std::string_view TASK_NAME = "Async TCP Sock Worker";
     static constexpr std::uint32_t TASK_STACK_SIZE = CONFIG_ASYNC_TCP_STACK;
-    static constexpr UBaseType_t TASK_PRIORITY = CONFIG_ASYNC_TCP_TASK_PRIORITY;
-    static constexpr BaseType_t TASK_CORE_AFFINITY = CONFIG_ASYNC_TCP_RUNNING_CORE;
-    static constexpr std::chrono::milliseconds POLL_INTERVAL{
-        CONFIG_ASYNC_TCP_POLL_INTERVAL};
-
-    mutable std::mutex managerMutex;
-    std::vector<ClientVariant> clients;
-    std::vector<ServerVariant> servers;
-    TaskHandle_t workerThread;
+    static constexpr unsigned TASK_PRIORITY = CONFIG_ASYNC_TCP_TASK_PRIORITY;
+    static constexpr int TASK_CORE_AFFINITY = CONFIG_ASYNC_TCP_RUNNING_CORE;
+    static constexpr std::size_t WORKER_COUNT = CONFIG_ASYNC_TCP_WORKERS;
+    // Signals and deadlines interrupt the wait for activity, leaving the socket limit
+    // is only noticed after this long
+    static constexpr std::chrono::milliseconds MAX_WAIT{1000};
+
+    static_assert(WORKER_COUNT >= 1 && WORKER_COUNT <= 255,
+                  "CONFIG_ASYNC_TCP_WORKERS must be between 1 and 255");
+
+    // Any managed client or server, or none
+    using ConnectionVariant =
+        typename detail::ConnectionVariantOf<ClientVariant, ServerVariant>::type;
+
+    enum class WorkType : std::uint8_t {
+        WRITABLE,
+        READABLE,
+        DNS_FINISHED,
+        // A deadline of the client passed
+        POLL,
+        // Only reschedule the client's timer
+        TIMERS_CHANGED,
+        // Writes were submitted to the client
+        SUBMITTED,
+        // The client is to be released
+        RELEASED,
+        PROCESSING_DONE,
+    };
+
+    // Flags for ConnectionRegistry::signal()
+    static constexpr std::uint8_t SIGNAL_DNS_FINISHED = 0b0001;
+    static constexpr std::uint8_t SIGNAL_CLOSED = 0b0010;
+    static constexpr std::uint8_t SIGNAL_TIMERS_CHANGED = 0b0100;
+    static constexpr std::uint8_t SIGNAL_SUBMITTED = 0b1000;
+    static constexpr std::uint8_t SIGNAL_RELEASED = 0b10000;
+
+    using Timers = TimerWheel<ConnectionHandle>;
+
+    struct Work {
+        ConnectionHandle connection;
+        WorkType type;
+    };
+
+    struct Shard {
+        SocketConnectionManager* manager = nullptr;
+        std::size_t index = 0;
+        // Connections of this shard. Registration and removal never block, neither
+        // the application nor the worker task.
+        ConnectionRegistry<ConnectionVariant> registry{CONFIG_ASYNC_TCP_MAX_CONNECTIONS};
+        // Work of the current iteration of the worker task, only accessed by the task.
+        // Connections removed in the meantime are skipped, since their handle is stale.
+        std::vector<Work> work{};
+        // Whether servers currently watch for new connections, only accessed by the task
+        bool serversAccepting = true;
+        // Deadlines of the clients, only accessed by the task. Each client has at most
+        // one live entry, for its earliest deadline.
+        Timers timers{};
+        Poller poller{};
+        // Packed handle of the connection the task is using, ConnectionHandle{} while it
+        // uses none. Removing that connection from another thread waits until it's done.
+        std::atomic<std::uint64_t> inUse{ConnectionHandle{}.pack()};
+        Platform::TaskHandle workerThread{};
+        // Scratch buffer the clients read into, only accessed by the task, which reads
+        // one socket at a time
+        std::array<std::uint8_t, CONFIG_ASYNC_TCP_RECV_BUFFER_SIZE> readBuffer{};
+    };
+
+    // The shard of the worker task running on this thread, if any
+    static inline thread_local const Shard* currentShard = nullptr;
+
+    std::array<Shard, WORKER_COUNT> shards;
+    std::atomic<ShardPolicy> shardPolicy;
+    // For ShardPolicy::ROUND_ROBIN
+    std::atomic<std::size_t> nextShard;
+    std::atomic<bool> running;
 
   public:
     static SocketConnectionManager<ClientVariant, ServerVariant>& instance();
 
-    template <ManagedClient Client>
-    void addConnection(Client* client) {
-        log_d_("Adding client %p", client);
+    /// Only affects connections added afterwards.
+    void setShardPolicy(ShardPolicy policy) {
+        shardPolicy = policy;
+    }
 
-        if (client != nullptr) {
-            std::lock_guard lock(managerMutex);
-            clients.emplace_back(client);
+    template <class Connection>
+    void addConnection(Connection* conn) {
+        log_d_("Adding %s %p", Connection::IS_SERVER ? "server" : "client", conn);
+
+        if (conn == nullptr) {
+            return;
+        }
+
+        const std::size_t index = selectShard(conn->getSocket());
+        const std::optional<ConnectionHandle> handle = shards[index].registry.add(conn);
+        if (!handle) {
+            log_e("Too many connections, %p will not be managed", conn);
+            return;
         }
-    }
-    template <ManagedServer Server>
-    void addConnection(Server* server) {
-        log_d_("Adding server %p", server);
 
-        if (server != nullptr) {
-            std::lock_guard lock(managerMutex);
-            servers.emplace_back(server);
+        conn->setShard(index);
+        conn->setHandle(*handle);
+        // Accepted connections already have a socket
+        _watch(conn, conn->getSocket());
+        if constexpr (!Connection::IS_SERVER) {
+            // Accepted connections may already have deadlines
+            _signal(shards[index], *handle, SIGNAL_TIMERS_CHANGED);
         }
     }
 
-    template <ManagedClient Client>
-    void removeConnection(Client* client) {
-        log_d_("Removing client %p", client);
+    template <class Connection>
+    void removeConnection(Connection* conn) {
+        log_d_("Removing %s %p", Connection::IS_SERVER ? "server" : "client", conn);
+
+        if (conn == nullptr) {
+            return;
+        }
 
-        if (client != nullptr) {
-            std::lock_guard lock(managerMutex);
-            std::erase(clients, ClientVariant{client});
+        // Pending work and signals of the connection are dropped with its handle
+        Shard& shard = shardOf(conn);
+        const ConnectionHandle handle = conn->getHandle();
+        shard.registry.remove(handle);
+
+        // The caller is about to close and destroy the connection, which the worker task
+        // may still be using. Pairs with the fence in withConnection(): either the task's
+        // lookup sees the removal or the task's use is seen here. The task's own
+        // callbacks can't be waited for and are done with it once they return.
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (handle.isValid() && currentShard != &shard) {
+            while (shard.inUse.load(std::memory_order_acquire) == handle.pack()) {
+                Platform::yield();
+            }
         }
+
+        conn->setHandle(ConnectionHandle{});
+    }
+
+    template <class Connection>
+    void watchSocket(Connection* conn, int socket) {
+        log_d_("Watching socket %d of %p", socket, conn);
+        _watch(conn, socket);
     }
-    template <ManagedServer Server>
-    void removeConnection(Server* server) {
-        log_d_("Removing client %p", server);
 
-        if (server != nullptr) {
-            std::lock_guard lock(managerMutex);
-            std::erase(servers, ServerVariant{server});
+    template <class Connection>
+    void unwatchSocket(Connection* conn, int socket) {
+        log_d_("Unwatching socket %d of %p", socket, conn);
+
+        Shard& shard = shardOf(conn);
+        shard.poller.remove(socket);
+
+        if constexpr (!Connection::IS_SERVER) {
+            // A closed client must still signal its disconnection
+            _signal(shard, conn->getHandle(), SIGNAL_CLOSED);
         }
     }
 
+    template <class Connection>
+    void updateInterest(Connection* conn, int socket, bool read, bool write) {
+        log_d_("Interest of socket %d of %p: read %d, write %d", socket, conn, read,
+               write);
+        shardOf(conn).poller.setInterest(socket, read, write);
+    }
+
+    template <ManagedClient Client>
+    void signalDnsFinished(Client* client) {
+        _signal(shardOf(client), client->getHandle(), SIGNAL_DNS_FINISHED);
+    }
+
+    template <ManagedClient Client>
+    void signalTimersChanged(Client* client) {
+        _signal(shardOf(client), client->getHandle(), SIGNAL_TIMERS_CHANGED);
+    }
+
+    template <ManagedClient Client>
+    void signalSubmitted(Client* client) {
+        _signal(shardOf(client), client->getHandle(), SIGNAL_SUBMITTED);
+    }
+
+    template <ManagedClient Client>
+    void signalReleased(Client* client) {
+        _signal(shardOf(client), client->getHandle(), SIGNAL_RELEASED);
+    }
+
   private:
-    template <class Func>
-    void iterateClients(Func&& fn) const {
-        std::lock_guard lock(managerMutex);
-        for (const ClientVariant& client : clients) {
-            // The function must not try to acquire the manager mutex, otherwise it
-            // deadlocks. This is unproblematic for every usage in
-            // updateConnectionStates(...).
-            std::visit(fn, client);
+    template <class Connection>
+    Shard& shardOf(Connection* conn) {
+        return shards[conn->getShard()];
+    }
+
+    // Signals from other threads interrupt the worker's wait. Its own are collected
+    // before it waits again.
+    void _signal(Shard& shard, ConnectionHandle handle, std::uint8_t flags) {
+        shard.registry.signal(handle, flags);
+        if (currentShard != &shard) {
+            shard.poller.wake();
         }
     }
 
+    // Looks up the connection and invokes fn with it, or with std::monostate if it has
+    // been removed. Other threads removing the connection wait until fn returns.
     template <class Func>
-    void iterateServers(Func&& fn) const {
-        std::lock_guard lock(managerMutex);
-        for (const ServerVariant& server : servers) {
-            // The function must not try to acquire the manager mutex, otherwise it
-            // deadlocks. This is unproblematic for every usage in
-            // updateConnectionStates(...).
-            std::visit(fn, server);
+    void withConnection(Shard& shard, ConnectionHandle handle, Func&& fn) {
+        shard.inUse.store(handle.pack(), std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        std::visit(std::forward<Func>(fn), shard.registry.get(handle));
+        // Released, so the removing thread sees everything done with the connection
+        shard.inUse.store(ConnectionHandle{}.pack(), std::memory_order_release);
+    }
+
+    template <class Connection>
+    void _watch(Connection* conn, int socket) {
+        if (socket >= 0 && conn->getHandle().isValid()) {
+            shardOf(conn).poller.add(socket, conn->getHandle().pack());
         }
     }
 
-    constexpr bool hasFreeSocket() const {
+    std::size_t selectShard(int socket);
+
+    bool hasFreeSocket() const {
 #ifdef CONFIG_LWIP_MAX_SOCKETS
-        // mutex must have been locked
-        return clients.size() + servers.size() < CONFIG_LWIP_MAX_SOCKETS;
+        std::size_t connections = 0;
+        for (const Shard& shard : shards) {
+            connections += shard.registry.size();
+        }
+        return connections < CONFIG_LWIP_MAX_SOCKETS;
 #else
         return true;
 #endif
     }
 
+    // Queue work for all ready sockets
+    void collectReadyWork(Shard& shard, std::span<const PollEvent> events);
+    // Queue work for all clients whose timer fired
+    void collectTimerWork(Shard& shard, std::chrono::steady_clock::time_point now);
+    // Arm the timer of the client for its next deadline, if that is earlier than the
+    // armed one
+    void scheduleTimer(Shard& shard, ConnectionHandle handle);
+    // Queue work for all clients signaled since the last call
+    void collectSignaledWork(Shard& shard);
+    // Enable or disable accepting on all servers
+    void updateServers(Shard& shard, bool accepting);
+    // Run and clear the queued work
+    void processWork(Shard& shard);
+
     static void updateConnectionStates(void*);
 
     SocketConnectionManager();
@@ -5,34 +5,17 @@
 
 //
 
+#include <algorithm>
 #include <chrono>
-#include <mutex>
+#include <cstring>
+#include <span>
 #include <stdexcept>
+#include <type_traits>
 
-#include <esp32-hal-log.h>
-#include <esp32-hal.h>
-#include <esp_task_wdt.h>
-#include <lwip/sockets.h>
-#include <sdkconfig.h>
+#include "Platform.hpp"
 
 namespace AsyncTcpSock {
 
-static void enter_wdt() {
-#if CONFIG_ASYNC_TCP_USE_WDT
-    if (esp_task_wdt_add(NULL) != ESP_OK) {
-        log_e("Failed to add async task to WDT");
-    }
-#endif
-}
-
-static void leave_wdt() {
-#if CONFIG_ASYNC_TCP_USE_WDT
-    if (esp_task_wdt_delete(NULL) != ESP_OK) {
-        log_e("Failed to remove loop task from WDT");
-    }
-#endif
-}
-
 //
 // SocketConnection
 //
@@ -44,6 +27,11 @@ inline SocketConnection::SocketConnection(int socket)
     _configureSocket(socket);
 }
 
+inline SocketConnection::SocketConnection(NonBlockingSocket socket)
+    : SocketConnection() {
+    _socket = socket.socket;
+}
+
 inline bool SocketConnection::isOpen() const {
     return _socket != -1;
 }
@@ -60,6 +48,22 @@ inline void SocketConnection::setDnsFinished(bool finished) {
     _dnsFinished = finished;
 }
 
+inline ConnectionHandle SocketConnection::getHandle() const {
+    return ConnectionHandle::unpack(_handle.load());
+}
+
+inline void SocketConnection::setHandle(ConnectionHandle handle) {
+    _handle = handle.pack();
+}
+
+inline std::size_t SocketConnection::getShard() const {
+    return _shard;
+}
+
+inline void SocketConnection::setShard(std::size_t shard) {
+    _shard = static_cast<std::uint8_t>(shard);
+}
+
 inline std::chrono::steady_clock::time_point SocketConnection::getLastActive() const {
     return _lastActive;
 }
@@ -68,6 +72,14 @@ inline void SocketConnection::setLastActive(std::chrono::steady_clock::time_poin
     _lastActive = when;
 }
 
+inline std::uint64_t SocketConnection::getTimerTick() const {
+    return _timerTick;
+}
+
+inline void SocketConnection::setTimerTick(std::uint64_t tick) {
+    _timerTick = tick;
+}
+
 inline void SocketConnection::_configureSocket(int socket) {
     int res = fcntl(socket, F_SETFL, fcntl(socket, F_GETFL, 0) | O_NONBLOCK);
     if (res < 0) {
@@ -78,6 +90,30 @@ inline void SocketConnection::_configureSocket(int socket) {
     _socket = socket;
 }
 
+inline socklen_t SocketConnection::_socketAddress(const IPAddress& ip,
+                                                  std::uint16_t port,
+                                                  sockaddr_storage& addr) {
+    addr = {};
+    if (ip.type() == IPv6) {
+        sockaddr_in6 in6{};
+        in6.sin6_family = AF_INET6;
+        in6.sin6_port = htons(port);
+        for (std::size_t i = 0; i < sizeof(in6.sin6_addr); ++i) {
+            reinterpret_cast<std::uint8_t*>(&in6.sin6_addr)[i] = ip[i];
+        }
+        in6.sin6_scope_id = ip.zone();
+        std::memcpy(&addr, &in6, sizeof(in6));
+        return sizeof(in6);
+    }
+
+    const sockaddr_in in{.sin_family = AF_INET,
+                         .sin_port = htons(port),
+                         .sin_addr = {.s_addr = static_cast<std::uint32_t>(ip)},
+                         .sin_zero = {}};
+    std::memcpy(&addr, &in, sizeof(in));
+    return sizeof(in);
+}
+
 //
 // SocketConnectionManager
 //
@@ -88,238 +124,331 @@ SocketConnectionManager<ClientVariant, ServerVariant>::instance() {
     return manager;
 }
 
-// The main work function responsible for updating each connection's state
-// according to the TCP state machine.
 template <ClientVariantType ClientVariant, ServerVariantType ServerVariant>
-void SocketConnectionManager<ClientVariant, ServerVariant>::updateConnectionStates(
-    void*) {
-    auto& manager = SocketConnectionManager::instance();
-
-    std::vector<ClientVariant> clientsProcessing;
-    std::vector<ServerVariant> serversProcessing;
-
-    log_d_("AsyncTCPSock worker task started");
-
-    while (true) {
-        fd_set sockSet_r;
-        fd_set sockSet_w;
-        int max_sock = 0;
-
-        // Collect all of the active sockets into socket set. Half-destroyed
-        // connections should have set _socket to -1 and therefore should not
-        // end up in the sockList.
-        FD_ZERO(&sockSet_r);
-        FD_ZERO(&sockSet_w);
-
-        log_d_("Collecting active sockets for select()...");
-
-        manager.iterateClients([&](auto&& it) {
-            const int socket = it->getSocket();
-            log_d_("Checking client %p with socket %d", it, socket);
-
-            if (socket != -1) {
-                max_sock = std::max(max_sock, socket + 1);
+void SocketConnectionManager<ClientVariant, ServerVariant>::collectReadyWork(
+    Shard& shard,
+    std::span<const PollEvent> events) {
+    // Writes first, then reads, so that a connection completing its connect() is marked
+    // connected before its first data is delivered.
+    for (const PollEvent& event : events) {
+        if (event.writable) {
+            shard.work.push_back(
+                Work{ConnectionHandle::unpack(event.token), WorkType::WRITABLE});
+        }
+    }
+    for (const PollEvent& event : events) {
+        if (event.readable) {
+            shard.work.push_back(
+                Work{ConnectionHandle::unpack(event.token), WorkType::READABLE});
+        }
+    }
+}
 
-                FD_SET(socket, &sockSet_r);
-                if (it->_pendingWrite()) {
-                    FD_SET(socket, &sockSet_w);
-                }
-            }
-        });
-        manager.iterateServers([&](auto&& it) {
-            const int socket = it->getSocket();
-            log_d_("Checking server %p with socket %d", it, socket);
-
-            if (socket != -1) {
-                if (manager.hasFreeSocket()) {
-                    FD_SET(socket, &sockSet_r);
-                    max_sock = std::max(max_sock, socket + 1);
+template <ClientVariantType ClientVariant, ServerVariantType ServerVariant>
+void SocketConnectionManager<ClientVariant, ServerVariant>::collectTimerWork(
+    Shard& shard,
+    std::chrono::steady_clock::time_point now) {
+    // Entries aren't removed when a client's deadline moves, superseded ones are skipped
+    // here. A deadline that moved later is found out when the work is run, which then
+    // arms the timer again.
+    shard.timers.advance(now, [&](ConnectionHandle handle, std::uint64_t tick) {
+        withConnection(shard, handle, [&](auto&& c) {
+            using Type = std::decay_t<decltype(c)>;
+
+            if constexpr (!std::is_same_v<Type, std::monostate>) {
+                if constexpr (!std::remove_pointer_t<Type>::IS_SERVER) {
+                    if (c->getTimerTick() == tick) {
+                        c->setTimerTick(Timers::NO_TICK);
+                        shard.work.push_back(Work{handle, WorkType::POLL});
+                    }
                 }
             }
         });
+    });
+}
 
-        // Wait for activity on all monitored sockets
-        struct timeval tv;
-        tv.tv_sec = 0;
-        tv.tv_usec = POLL_INTERVAL.count() * 1000;
-
-        int success = select(max_sock, &sockSet_r, &sockSet_w, NULL, &tv);
-        if (success > 0) {
-            {
-                log_d_("Writing to writable client sockets...");
-
-                // Collect and notify all writable sockets. Half-destroyed connections
-                // should have set _socket to -1 and therefore should not end up in
-                // the sockList.
-                manager.iterateClients([&](auto&& it) {
-                    if (FD_ISSET(it->getSocket(), &sockSet_w)) {
-                        clientsProcessing.push_back(it);
-                    }
-                });
-
-                for (const ClientVariant& client : clientsProcessing) {
-                    enter_wdt();
-                    std::visit(
-                        [](auto&& c) {
-                            const bool activity = c->_sockIsWriteable();
-                            if (activity) {
-                                c->setLastActive();
-                            }
-                        },
-                        client);
-                    leave_wdt();
+template <ClientVariantType ClientVariant, ServerVariantType ServerVariant>
+void SocketConnectionManager<ClientVariant, ServerVariant>::scheduleTimer(
+    Shard& shard,
+    ConnectionHandle handle) {
+    withConnection(shard, handle, [&](auto&& c) {
+        using Type = std::decay_t<decltype(c)>;
+
+        if constexpr (!std::is_same_v<Type, std::monostate>) {
+            if constexpr (!std::remove_pointer_t<Type>::IS_SERVER) {
+                const auto deadline = c->_nextDeadline();
+                if (deadline == std::chrono::steady_clock::time_point::max()) {
+                    // An armed entry still fires, but finds nothing to do
+                    return;
                 }
 
-                clientsProcessing.clear();
-            }
-            {
-                log_d_("Reading from readable client sockets...");
-
-                // Collect and notify all readable sockets. Half-destroyed connections
-                // should have set _socket to -1 and therefore should not end up in
-                // the sockList.
-                manager.iterateClients([&](auto&& it) {
-                    if (FD_ISSET(it->getSocket(), &sockSet_r)) {
-                        clientsProcessing.push_back(it);
-                    }
-                });
-
-                for (const ClientVariant& client : clientsProcessing) {
-                    enter_wdt();
-                    std::visit(
-                        [](auto&& c) {
-                            c->setLastActive();
-                            c->_sockIsReadable();
-                        },
-                        client);
-                    leave_wdt();
+                // A later deadline keeps the armed entry
+                const std::uint64_t tick = shard.timers.tickAt(deadline);
+                if (tick < c->getTimerTick()) {
+                    c->setTimerTick(shard.timers.schedule(handle, tick));
                 }
-
-                clientsProcessing.clear();
             }
-            {
-                log_d_("Reading from readable server sockets...");
-
-                // Collect and notify all readable sockets. Half-destroyed connections
-                // should have set _socket to -1 and therefore should not end up in
-                // the sockList.
-                manager.iterateServers([&](auto&& it) {
-                    if (FD_ISSET(it->getSocket(), &sockSet_r)) {
-                        serversProcessing.push_back(it);
-                    }
-                });
-
-                for (const ServerVariant& server : serversProcessing) {
-                    enter_wdt();
-                    std::visit(
-                        [](auto&& server) {
-                            server->setLastActive();
-                            server->_sockIsReadable();
-                        },
-                        server);
-                    leave_wdt();
-                }
+        }
+    });
+}
 
-                serversProcessing.clear();
+template <ClientVariantType ClientVariant, ServerVariantType ServerVariant>
+void SocketConnectionManager<ClientVariant, ServerVariant>::collectSignaledWork(
+    Shard& shard) {
+    shard.registry.takeSignaled(
+        [&](ConnectionHandle handle, const ConnectionVariant&, std::uint8_t flags) {
+            if (flags & SIGNAL_DNS_FINISHED) {
+                shard.work.push_back(Work{handle, WorkType::DNS_FINISHED});
             }
-        }
+            if (flags & SIGNAL_CLOSED) {
+                shard.work.push_back(Work{handle, WorkType::PROCESSING_DONE});
+            }
+            if (flags & SIGNAL_TIMERS_CHANGED) {
+                shard.work.push_back(Work{handle, WorkType::TIMERS_CHANGED});
+            }
+            if (flags & SIGNAL_SUBMITTED) {
+                shard.work.push_back(Work{handle, WorkType::SUBMITTED});
+            }
+            // Last, the release may delete the client
+            if (flags & SIGNAL_RELEASED) {
+                shard.work.push_back(Work{handle, WorkType::RELEASED});
+            }
+        });
+}
 
-        {
-            log_d_("Updating clients with finished DNS resolution...");
+template <ClientVariantType ClientVariant, ServerVariantType ServerVariant>
+void SocketConnectionManager<ClientVariant, ServerVariant>::updateServers(
+    Shard& shard,
+    bool accepting) {
+    // The connections are only used once they are looked up again
+    shard.registry.forEach([&](ConnectionHandle handle, const ConnectionVariant&) {
+        withConnection(shard, handle, [&](auto&& c) {
+            using Type = std::decay_t<decltype(c)>;
+
+            if constexpr (!std::is_same_v<Type, std::monostate>) {
+                if constexpr (std::remove_pointer_t<Type>::IS_SERVER) {
+                    const int socket = c->getSocket();
+                    log_d_("Server %p with socket %d accepting: %d", c, socket,
+                           accepting);
+                    shard.poller.setInterest(socket, accepting, false);
+                }
+            }
+        });
+    });
+}
 
-            // Collect and notify all sockets waiting for DNS completion
-            manager.iterateClients([&](auto&& it) {
-                // Collect socket that has finished resolving DNS (with or without
-                // error)
-                if (it->isDnsFinished()) {
-                    clientsProcessing.push_back(it);
+template <ClientVariantType ClientVariant, ServerVariantType ServerVariant>
+void SocketConnectionManager<ClientVariant, ServerVariant>::processWork(Shard& shard) {
+    // Callbacks may remove any connection, so each item is only looked up right before
+    // it is run. Removed connections resolve to std::monostate. Other threads removing
+    // the connection meanwhile wait until the item is done.
+    for (std::size_t i = 0; i < shard.work.size(); ++i) {
+        const Work item = shard.work[i];
+
+        Platform::enterWdt();
+        withConnection(shard, item.connection, [&](auto&& conn) {
+            using Type = std::decay_t<decltype(conn)>;
+
+            if constexpr (std::is_same_v<Type, std::monostate>) {
+                // Removed or socket no longer watched
+            } else if constexpr (std::remove_pointer_t<Type>::IS_SERVER) {
+                conn->setLastActive();
+                conn->_sockIsReadable();
+            } else {
+                switch (item.type) {
+                    case WorkType::WRITABLE:
+                        if (conn->_sockIsWriteable()) {
+                            conn->setLastActive();
+                        }
+                        break;
+                    case WorkType::READABLE:
+                        conn->setLastActive();
+                        conn->_sockIsReadable(shard.readBuffer);
+                        break;
+                    case WorkType::DNS_FINISHED:
+                        conn->setDnsFinished(false);
+                        conn->_sockDelayedConnect();
+                        break;
+                    case WorkType::POLL:
+                        conn->_sockPoll();
+                        break;
+                    case WorkType::TIMERS_CHANGED:
+                        break;
+                    case WorkType::SUBMITTED:
+                        conn->_sockSubmitted();
+                        break;
+                    case WorkType::RELEASED:
+                        conn->_sockReleased();
+                        break;
+                    case WorkType::PROCESSING_DONE:
+                        conn->_processingDone();
+                        break;
                 }
-            });
-
-            for (const ClientVariant& client : clientsProcessing) {
-                enter_wdt();
-                std::visit(
-                    [](auto&& c) {
-                        c->setDnsFinished(false);
-                        c->_sockDelayedConnect();
-                    },
-                    client);
-                leave_wdt();
             }
+        });
 
-            clientsProcessing.clear();
+        // Reads only move deadlines later, which the armed entry finds out by itself.
+        // Callbacks adding deadlines signal them or make the socket writable. The
+        // client is looked up again, the work may have removed it.
+        if (item.type != WorkType::READABLE && item.type != WorkType::PROCESSING_DONE) {
+            scheduleTimer(shard, item.connection);
         }
+        Platform::leaveWdt();
+    }
 
-        {
-            log_d_("Polling clients to check timeouts...");
+    shard.work.clear();
+}
 
-            // Collect and run activity poll on all pollable sockets
-            manager.iterateClients([&](auto&& it) {
-                const auto now = std::chrono::steady_clock::now();
+template <ClientVariantType ClientVariant, ServerVariantType ServerVariant>
+std::size_t SocketConnectionManager<ClientVariant, ServerVariant>::selectShard(
+    int socket) {
+    if constexpr (WORKER_COUNT == 1) {
+        return 0;
+    }
 
-                if (now - it->getLastActive() >= POLL_INTERVAL) {
-                    it->setLastActive(std::move(now));
-                    clientsProcessing.push_back(it);
-                }
-            });
+    switch (shardPolicy.load()) {
+        case ShardPolicy::LEAST_LOADED:
+            return std::min_element(shards.begin(), shards.end(),
+                                    [](const Shard& lhs, const Shard& rhs) {
+                                        return lhs.registry.size() < rhs.registry.size();
+                                    })
+                ->index;
+
+        case ShardPolicy::REMOTE_ADDRESS_HASH: {
+            sockaddr_storage peer{};
+            socklen_t peerSize = sizeof(peer);
+            if (socket < 0 ||
+                getpeername(socket, reinterpret_cast<sockaddr*>(&peer), &peerSize) < 0) {
+                break;
+            }
 
-            // Run activity poll on all pollable sockets
-            for (const ClientVariant& client : clientsProcessing) {
-                enter_wdt();
-                std::visit([](auto&& c) { c->_sockPoll(); }, client);
-                leave_wdt();
+            std::span<const std::uint8_t> address;
+            if (peer.ss_family == AF_INET) {
+                const auto& in = reinterpret_cast<const sockaddr_in&>(peer);
+                address = std::span(reinterpret_cast<const std::uint8_t*>(&in.sin_addr),
+                                    sizeof(in.sin_addr));
+            } else if (peer.ss_family == AF_INET6) {
+                const auto& in6 = reinterpret_cast<const sockaddr_in6&>(peer);
+                address = std::span(reinterpret_cast<const std::uint8_t*>(&in6.sin6_addr),
+                                    sizeof(in6.sin6_addr));
+            } else {
+                break;
             }
 
-            clientsProcessing.clear();
+            // FNV-1a
+            std::uint32_t hash = 2166136261u;
+            for (std::uint8_t byte : address) {
+                hash = (hash ^ byte) * 16777619u;
+            }
+            return hash % WORKER_COUNT;
         }
 
-        {
-            log_d_("Cleaning up clients...");
-
-            // Collect and run activity poll on all pollable sockets
-            manager.iterateClients([&](auto&& it) { clientsProcessing.push_back(it); });
+        case ShardPolicy::ROUND_ROBIN:
+            break;
+    }
 
-            // Run activity poll on all pollable sockets
-            for (const ClientVariant& client : clientsProcessing) {
-                std::visit([](auto&& c) { c->_processingDone(); }, client);
-            }
+    return nextShard.fetch_add(1, std::memory_order_relaxed) % WORKER_COUNT;
+}
 
-            clientsProcessing.clear();
+// The main work function responsible for updating each connection's state
+// according to the TCP state machine. Each shard runs its own instance.
+template <ClientVariantType ClientVariant, ServerVariantType ServerVariant>
+void SocketConnectionManager<ClientVariant, ServerVariant>::updateConnectionStates(
+    void* arg) {
+    auto& shard = *static_cast<Shard*>(arg);
+    auto& manager = *shard.manager;
+    currentShard = &shard;
+
+    log_d_("AsyncTCPSock worker task %zu started", shard.index);
+
+    while (manager.running) {
+        // Sockets are registered with the poller when they are opened and unregistered
+        // before they are closed. Clients report changes of their interest themselves,
+        // only servers need to be updated when the socket limit is reached or left.
+        if (manager.hasFreeSocket() != shard.serversAccepting) {
+            shard.serversAccepting = !shard.serversAccepting;
+            manager.updateServers(shard, shard.serversAccepting);
         }
+
+        // Wait for activity on all monitored sockets, at most until the next deadline.
+        // Other threads wake the poller when they signal a connection or change its
+        // interest. Signals raised by this task during the last iteration are pending.
+        const auto start = std::chrono::steady_clock::now();
+        const auto wakeUp = std::min(shard.timers.nextExpiry(), start + MAX_WAIT);
+        const auto timeout =
+            shard.registry.hasSignaled()
+                ? std::chrono::milliseconds(0)
+                : std::chrono::ceil<std::chrono::milliseconds>(wakeUp - start);
+        const std::span<const PollEvent> events =
+            shard.poller.wait(std::max(timeout, std::chrono::milliseconds(0)));
+
+        // Only connections with activity or a passed deadline are visited
+        log_d_("Processing %zu ready sockets...", events.size());
+        manager.collectReadyWork(shard, events);
+        manager.processWork(shard);
+
+        log_d_("Processing passed deadlines...");
+        manager.collectTimerWork(shard, std::chrono::steady_clock::now());
+        manager.processWork(shard);
+
+        log_d_("Processing finished DNS resolutions and closed clients...");
+        manager.collectSignaledWork(shard);
+        manager.processWork(shard);
     }
 }
 
 template <ClientVariantType ClientVariant, ServerVariantType ServerVariant>
 SocketConnectionManager<ClientVariant, ServerVariant>::SocketConnectionManager()
-    : managerMutex(), clients(), servers(), workerThread(nullptr) {
-    clients.reserve(CONFIG_LWIP_MAX_SOCKETS);
-    servers.reserve(2);
-
-    log_i(
-        "Creating worker task for AsyncTCPSock, name: %s, stack: %d, prio: %d, "
-        "affinity: "
-        "%d",
-        TASK_NAME.data(), TASK_STACK_SIZE, TASK_PRIORITY, TASK_CORE_AFFINITY);
-    auto result =
-        xTaskCreateUniversal(updateConnectionStates, TASK_NAME.data(), TASK_STACK_SIZE,
-                             nullptr, TASK_PRIORITY, &workerThread, TASK_CORE_AFFINITY);
-    if (result != pdPASS) {
-        log_e(
-            "Failed to create FreeRTOS task for AsyncTCPSock. TCP communication will "
-            "not "
-            "be available.");
-        throw std::runtime_error("Failed to create AsyncTCPSock task");
+    : shards(),
+      shardPolicy(ShardPolicy::LEAST_LOADED),
+      nextShard(0),
+      running(true) {
+    for (std::size_t i = 0; i < WORKER_COUNT; ++i) {
+        Shard& shard = shards[i];
+        shard.manager = this;
+        shard.index = i;
+#ifdef CONFIG_LWIP_MAX_SOCKETS
+        shard.work.reserve(2 * CONFIG_LWIP_MAX_SOCKETS);
+#endif
+
+        // Spread pinned workers over the cores, starting at the configured one
+        const int affinity =
+            TASK_CORE_AFFINITY < 0
+                ? TASK_CORE_AFFINITY
+                : static_cast<int>((TASK_CORE_AFFINITY + i) % Platform::coreCount());
+
+        log_i(
+            "Creating worker task %zu for AsyncTCPSock, name: %s, stack: %d, prio: %d, "
+            "affinity: %d",
+            i, TASK_NAME.data(), TASK_STACK_SIZE, TASK_PRIORITY, affinity);
+        const bool created =
+            Platform::createTask(updateConnectionStates, TASK_NAME.data(),
+                                 TASK_STACK_SIZE, TASK_PRIORITY, affinity, &shard,
+                                 shard.workerThread);
+        if (!created) {
+            log_e(
+                "Failed to create worker task for AsyncTCPSock. TCP communication will "
+                "not be available.");
+            running = false;
+            for (std::size_t j = 0; j < i; ++j) {
+                shards[j].poller.wake();
+                Platform::deleteTask(shards[j].workerThread);
+            }
+            throw std::runtime_error("Failed to create AsyncTCPSock task");
+        }
     }
 }
 
 template <ClientVariantType ClientVariant, ServerVariantType ServerVariant>
 SocketConnectionManager<ClientVariant,
                         ServerVariant>::~SocketConnectionManager() noexcept {
-    if (workerThread != nullptr) {
-        vTaskDelete(workerThread);
+    running = false;
+    for (Shard& shard : shards) {
+        shard.poller.wake();
+        Platform::deleteTask(shard.workerThread);
     }
 }
 
 }  // namespace AsyncTcpSock
 
-#endif
\ No newline at end of file
+#endif
@@ -13,28 +13,32 @@ bool SslClient::connect(const char* host, std::uint16_t port) {
     return ClientBase::connect(host, port);
 }
 
-void SslClient::setRootCa(const char* rootca, const size_t len) {
+void SslClient::setRootCa([[maybe_unused]] const char* rootca,
+                          [[maybe_unused]] const size_t len) {
 #if ASYNC_TCP_SSL_ENABLED
     _root_ca = (char*)rootca;
     _root_ca_len = len;
 #endif
 }
 
-void SslClient::setClientCert(const char* cli_cert, const size_t len) {
+void SslClient::setClientCert([[maybe_unused]] const char* cli_cert,
+                              [[maybe_unused]] const size_t len) {
 #if ASYNC_TCP_SSL_ENABLED
     _cli_cert = (char*)cli_cert;
     _cli_cert_len = len;
 #endif
 }
 
-void SslClient::setClientKey(const char* cli_key, const size_t len) {
+void SslClient::setClientKey([[maybe_unused]] const char* cli_key,
+                             [[maybe_unused]] const size_t len) {
 #if ASYNC_TCP_SSL_ENABLED
     _cli_key = (char*)cli_key;
     _cli_key_len = len;
 #endif
 }
 
-void SslClient::setPsk(const char* psk_ident, const char* psk) {
+void SslClient::setPsk([[maybe_unused]] const char* psk_ident,
+                       [[maybe_unused]] const char* psk) {
 #if ASYNC_TCP_SSL_ENABLED
     _psk_ident = psk_ident;
     _psk = psk;
@@ -99,6 +103,13 @@ bool SslClient::_processWriteQueue(std::unique_lock<std::mutex>&) {
     return false;
 }
 
+std::optional<std::size_t> SslClient::_writeDirect(const std::uint8_t*,
+                                                   std::size_t,
+                                                   ClientApiFlags) {
+    // Everything is written through the TLS context
+    return std::nullopt;
+}
+
 bool SslClient::_sockIsWriteable() {
 #if ASYNC_TCP_SSL_ENABLED
     if ((_conn_state == 2 || _conn_state == 3) && _secure) {
@@ -143,7 +154,7 @@ bool SslClient::_sockIsWriteable() {
     return false;
 }
 
-void SslClient::_sockIsReadable() {
+void SslClient::_sockIsReadable([[maybe_unused]] std::span<std::uint8_t> scratch) {
 #if ASYNC_TCP_SSL_ENABLED
     if (_sslctx != NULL) {
         if (!_handshake_done) {
@@ -20,10 +20,13 @@ class SslClient : public Client {
     // ClientBase
     void _close() override;
     bool _processWriteQueue(std::unique_lock<std::mutex>& writeQueueLock) override;
+    std::optional<std::size_t> _writeDirect(const std::uint8_t* data,
+                                            std::size_t size,
+                                            ClientApiFlags apiFlags) override;
 
     // SocketConnection
     bool _sockIsWriteable();
-    void _sockIsReadable();
+    void _sockIsReadable(std::span<std::uint8_t> scratch);
 };
 
 }  // namespace AsyncTcpSock
@@ -0,0 +1,242 @@
+#ifndef ASYNCTCPSOCK_STATICCLIENT_HPP
+#define ASYNCTCPSOCK_STATICCLIENT_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+
+#include "Callbacks.hpp"
+#include "ClientBase.hpp"
+#include "ObjectPool.hpp"
+#include "ServerBase.hpp"
+#include "SocketConnection.hpp"
+
+namespace AsyncTcpSock {
+
+namespace detail {
+// The argument of an event of a StaticClient, which has nothing to pass. One type per
+// event, so that they take no space.
+template <ClientCallbackType TYPE>
+struct NoArg {};
+
+// Handler of a StaticClient for an event its Handler has no member for, also one type
+// per event
+template <ClientCallbackType TYPE>
+struct NoHandler {
+    explicit constexpr operator bool() const {
+        return false;
+    }
+
+    void operator()(auto&&...) const {
+    }
+};
+
+// Handler of a StaticClient for the event TYPE, calls the member of its Handler
+template <ClientCallbackType TYPE>
+struct HandlerMember {
+    template <class Client, class... Args>
+    void operator()(NoArg<TYPE>, Client* client, Args&&... args) const {
+        auto& handler = client->handler();
+        if constexpr (TYPE == ClientCallbackType::CONNECT) {
+            handler.onConnect(client, std::forward<Args>(args)...);
+        } else if constexpr (TYPE == ClientCallbackType::DISCONNECT) {
+            handler.onDisconnect(client, std::forward<Args>(args)...);
+        } else if constexpr (TYPE == ClientCallbackType::POLL) {
+            handler.onPoll(client, std::forward<Args>(args)...);
+        } else if constexpr (TYPE == ClientCallbackType::SENT) {
+            handler.onAck(client, std::forward<Args>(args)...);
+        } else if constexpr (TYPE == ClientCallbackType::RECV) {
+            handler.onData(client, std::forward<Args>(args)...);
+        } else if constexpr (TYPE == ClientCallbackType::RECV_BUFFER) {
+            handler.onBuffer(client, std::forward<Args>(args)...);
+        } else if constexpr (TYPE == ClientCallbackType::AVAILABLE) {
+            handler.onAvailable(client, std::forward<Args>(args)...);
+        } else if constexpr (TYPE == ClientCallbackType::WRITABLE) {
+            handler.onWritable(client, std::forward<Args>(args)...);
+        } else if constexpr (TYPE == ClientCallbackType::ERROR) {
+            handler.onError(client, std::forward<Args>(args)...);
+        } else if constexpr (TYPE == ClientCallbackType::TIMEOUT) {
+            handler.onTimeout(client, std::forward<Args>(args)...);
+        } else {
+            static_assert(detail::dependentFalse<TYPE>, "Invalid ClientCallbackType");
+        }
+    }
+};
+
+// Whether Handler has a member for the event TYPE
+template <ClientCallbackType TYPE, class Handler, class Client>
+constexpr bool handlerHas() {
+    if constexpr (TYPE == ClientCallbackType::CONNECT) {
+        return requires(Handler h, Client* c) { h.onConnect(c); };
+    } else if constexpr (TYPE == ClientCallbackType::DISCONNECT) {
+        return requires(Handler h, Client* c) { h.onDisconnect(c); };
+    } else if constexpr (TYPE == ClientCallbackType::POLL) {
+        return requires(Handler h, Client* c) { h.onPoll(c); };
+    } else if constexpr (TYPE == ClientCallbackType::SENT) {
+        return requires(Handler h, Client* c, std::size_t len, std::uint32_t delay) {
+            h.onAck(c, len, delay);
+        };
+    } else if constexpr (TYPE == ClientCallbackType::RECV) {
+        return requires(Handler h, Client* c, void* data, std::size_t len) {
+            h.onData(c, data, len);
+        };
+    } else if constexpr (TYPE == ClientCallbackType::RECV_BUFFER) {
+        return requires(Handler h, Client* c, RecvBuffer buffer) {
+            h.onBuffer(c, std::move(buffer));
+        };
+    } else if constexpr (TYPE == ClientCallbackType::AVAILABLE) {
+        return requires(Handler h, Client* c) { h.onAvailable(c); };
+    } else if constexpr (TYPE == ClientCallbackType::WRITABLE) {
+        return requires(Handler h, Client* c) { h.onWritable(c); };
+    } else if constexpr (TYPE == ClientCallbackType::ERROR) {
+        return requires(Handler h, Client* c, int errorCode) { h.onError(c, errorCode); };
+    } else if constexpr (TYPE == ClientCallbackType::TIMEOUT) {
+        return requires(Handler h, Client* c, std::uint32_t delay) {
+            h.onTimeout(c, delay);
+        };
+    } else {
+        static_assert(detail::dependentFalse<TYPE>, "Invalid ClientCallbackType");
+    }
+}
+
+template <ClientCallbackType TYPE, class Handler, class Client>
+using HandlerOf = std::conditional_t<handlerHas<TYPE, Handler, Client>(),
+                                     HandlerMember<TYPE>,
+                                     NoHandler<TYPE>>;
+
+// ClientCallbacks whose handlers are the members of Handler
+template <class Client, class Handler>
+using StaticCallbacks =
+    ClientCallbacks<Client,
+                    NoArg<ClientCallbackType::CONNECT>,
+                    HandlerOf<ClientCallbackType::CONNECT, Handler, Client>,
+                    NoArg<ClientCallbackType::DISCONNECT>,
+                    HandlerOf<ClientCallbackType::DISCONNECT, Handler, Client>,
+                    NoArg<ClientCallbackType::POLL>,
+                    HandlerOf<ClientCallbackType::POLL, Handler, Client>,
+                    NoArg<ClientCallbackType::SENT>,
+                    HandlerOf<ClientCallbackType::SENT, Handler, Client>,
+                    NoArg<ClientCallbackType::RECV>,
+                    HandlerOf<ClientCallbackType::RECV, Handler, Client>,
+                    NoArg<ClientCallbackType::ERROR>,
+                    HandlerOf<ClientCallbackType::ERROR, Handler, Client>,
+                    NoArg<ClientCallbackType::TIMEOUT>,
+                    HandlerOf<ClientCallbackType::TIMEOUT, Handler, Client>,
+                    NoArg<ClientCallbackType::RECV_BUFFER>,
+                    HandlerOf<ClientCallbackType::RECV_BUFFER, Handler, Client>,
+                    NoArg<ClientCallbackType::AVAILABLE>,
+                    HandlerOf<ClientCallbackType::AVAILABLE, Handler, Client>,
+                    NoArg<ClientCallbackType::WRITABLE>,
+                    HandlerOf<ClientCallbackType::WRITABLE, Handler, Client>>;
+}  // namespace detail
+
+/**
+ * Client whose callbacks are the member functions of one Handler object, so they can be
+ * inlined and nothing is stored per event. The members are optional and named like the
+ * setters of Client:
+ *
+ *   onConnect(Client*), onDisconnect(Client*), onPoll(Client*),
+ *   onAck(Client*, std::size_t len, std::uint32_t delayMillis),
+ *   onData(Client*, void* data, std::size_t len), onBuffer(Client*, RecvBuffer),
+ *   onAvailable(Client*), onWritable(Client*), onError(Client*, int errorCode),
+ *   onTimeout(Client*, std::uint32_t delayMillis)
+ *
+ * Handler must be listed in ASYNC_TCP_STATIC_CLIENT_HANDLERS, so that the manager of
+ * Client and Server takes care of these clients too.
+ */
+template <class Handler>
+class StaticClient
+    : public ClientBase<StaticClient<Handler>,
+                        detail::StaticCallbacks<StaticClient<Handler>, Handler>> {
+    using Base = ClientBase<StaticClient<Handler>,
+                            detail::StaticCallbacks<StaticClient<Handler>, Handler>>;
+
+    [[no_unique_address]] Handler _handler{};
+
+  public:
+    static constexpr bool IS_SERVER = false;
+
+    StaticClient()
+        : Base() {
+        manage(this);
+    }
+
+    StaticClient(int socket)
+        : Base(socket) {
+        manage(this);
+    }
+
+    StaticClient(NonBlockingSocket socket)
+        : Base(socket) {
+        manage(this);
+    }
+
+    ~StaticClient() noexcept override {
+        // Unmanage before closing, like Client
+        unmanage(this);
+        this->close();
+    }
+
+    StaticClient(const StaticClient& other) = delete;
+    StaticClient(StaticClient&& other) = delete;
+
+    StaticClient& operator=(const StaticClient& other) = delete;
+    StaticClient& operator=(StaticClient&& other) = delete;
+
+    /// Storage for clients accepted by a StaticServer, like Client::pool()
+    static ObjectPool<StaticClient>& pool() {
+        // Never destroyed, clients may outlive static destruction
+        static ObjectPool<StaticClient>* pool =
+            new ObjectPool<StaticClient>(CONFIG_ASYNC_TCP_CLIENT_POOL_SIZE);
+        return *pool;
+    }
+
+    static void* operator new(std::size_t size) {
+        return ::operator new(size);
+    }
+
+    static void operator delete(void* ptr) {
+        pool().deallocate(ptr);
+    }
+
+    Handler& handler() {
+        return _handler;
+    }
+
+    const Handler& handler() const {
+        return _handler;
+    }
+};
+
+/// Server accepting into StaticClient<Handler>
+template <class Handler>
+class StaticServer : public ServerBase<StaticServer<Handler>, StaticClient<Handler>> {
+    using Base = ServerBase<StaticServer<Handler>, StaticClient<Handler>>;
+
+  public:
+    StaticServer(std::uint16_t port)
+        : Base(port) {
+        manage(this);
+    }
+
+    StaticServer(IPAddress addr, std::uint16_t port)
+        : Base(addr, port) {
+        manage(this);
+    }
+
+    ~StaticServer() noexcept override {
+        unmanage(this);
+        this->end();
+    }
+
+    StaticServer(const StaticServer& other) = delete;
+    StaticServer(StaticServer&& other) = delete;
+
+    StaticServer& operator=(const StaticServer& other) = delete;
+    StaticServer& operator=(StaticServer&& other) = delete;
+};
+
+}  // namespace AsyncTcpSock
+
+#endif
@@ -0,0 +1,191 @@
+#ifndef ASYNCTCPSOCK_TIMERWHEEL_HPP
+#define ASYNCTCPSOCK_TIMERWHEEL_HPP
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <utility>
+#include <vector>
+
+namespace AsyncTcpSock {
+
+/**
+ * Hierarchical timer wheel with millisecond ticks: LEVELS levels of SLOTS slots, each
+ * slot of a level spanning SLOTS slots of the level below. Scheduling is O(1), and an
+ * entry is moved down at most once per level before it fires. Entries further out than
+ * the wheel spans wait in the last level and are placed again when they come up.
+ *
+ * Entries can't be cancelled. Owners are expected to remember the tick they scheduled
+ * and to ignore entries with any other tick when they fire. Not thread-safe.
+ */
+template <class Id>
+class TimerWheel {
+  public:
+    using Clock = std::chrono::steady_clock;
+    using Tick = std::uint64_t;
+
+    static constexpr Tick NO_TICK = std::numeric_limits<Tick>::max();
+
+  private:
+    static constexpr std::size_t LEVELS = 4;
+    static constexpr unsigned SLOT_BITS = 6;
+    static constexpr std::size_t SLOTS = std::size_t(1) << SLOT_BITS;
+    static constexpr Tick SPAN = Tick(1) << (SLOT_BITS * LEVELS);
+
+    struct Entry {
+        Id id;
+        Tick tick;
+    };
+
+    struct Level {
+        std::array<std::vector<Entry>, SLOTS> slots{};
+        std::size_t size = 0;
+    };
+
+    std::array<Level, LEVELS> _levels{};
+    // Slot contents being fired or moved down, kept for its capacity
+    std::vector<Entry> _due{};
+    Clock::time_point _origin = Clock::now();
+    // Next tick to be processed, everything before has fired
+    Tick _current = 0;
+
+  public:
+    bool empty() const {
+        for (const Level& level : _levels) {
+            if (level.size != 0) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /// First tick at or after the given time
+    Tick tickAt(Clock::time_point when) const {
+        if (when <= _origin) {
+            return 0;
+        }
+        return std::chrono::ceil<std::chrono::milliseconds>(when - _origin).count();
+    }
+
+    Clock::time_point timeOf(Tick tick) const {
+        return _origin + std::chrono::milliseconds(tick);
+    }
+
+    /// Fire id at the given tick, or with the next advance() if it has passed already.
+    /// Returns the tick the entry was scheduled for.
+    Tick schedule(Id id, Tick tick) {
+        tick = std::max(tick, _current);
+        _insert(Entry{id, tick});
+        return tick;
+    }
+
+    /// When advance() has something to do next: fire an entry or move entries down to a
+    /// lower level. Clock::time_point::max() if the wheel is empty.
+    Clock::time_point nextExpiry() const {
+        Tick next = NO_TICK;
+
+        // Entries of the first level are exact and all within one revolution
+        const Level& first = _levels[0];
+        for (std::size_t i = 0; first.size != 0 && i < SLOTS; ++i) {
+            if (!first.slots[(_current + i) % SLOTS].empty()) {
+                next = _current + i;
+                break;
+            }
+        }
+
+        for (std::size_t level = 1; level < LEVELS; ++level) {
+            if (_levels[level].size != 0) {
+                next = std::min(next, _nextBoundary(level));
+                break;
+            }
+        }
+
+        return next == NO_TICK ? Clock::time_point::max() : timeOf(next);
+    }
+
+    /// Invoke fire(id, tick) for every entry due at the given time
+    template <class Fire>
+    void advance(Clock::time_point now, Fire&& fire) {
+        if (now < _origin) {
+            return;
+        }
+        const Tick last =
+            std::chrono::floor<std::chrono::milliseconds>(now - _origin).count();
+
+        while (_current <= last) {
+            // Skip ahead while there is nothing to fire or move down
+            std::size_t lowest = 0;
+            while (lowest < LEVELS && _levels[lowest].size == 0) {
+                ++lowest;
+            }
+            if (lowest == LEVELS) {
+                _current = last + 1;
+                return;
+            }
+            if (lowest > 0) {
+                // Not past now, entries scheduled later may be due earlier than the
+                // boundary
+                const Tick boundary = _nextBoundary(lowest);
+                if (boundary > last) {
+                    _current = last + 1;
+                    return;
+                }
+                _current = boundary;
+            }
+
+            // Move entries down, starting with the highest level whose slot begins now
+            for (std::size_t level = LEVELS - 1; level > 0; --level) {
+                if ((_current & ((Tick(1) << (SLOT_BITS * level)) - 1)) == 0) {
+                    _takeSlot(level, _current >> (SLOT_BITS * level));
+                    for (const Entry& entry : _due) {
+                        _insert(entry);
+                    }
+                }
+            }
+
+            // Entries scheduled by fire() land in later ticks
+            const Tick tick = _current++;
+            _takeSlot(0, tick);
+            for (const Entry& entry : _due) {
+                fire(entry.id, entry.tick);
+            }
+        }
+    }
+
+  private:
+    // First tick from _current on at which a slot of the level begins
+    Tick _nextBoundary(std::size_t level) const {
+        const Tick mask = (Tick(1) << (SLOT_BITS * level)) - 1;
+        return (_current + mask) & ~mask;
+    }
+
+    void _insert(const Entry& entry) {
+        // Far entries are placed at the end of the wheel's span and placed again once
+        // they come up
+        const Tick delta = std::min(entry.tick - _current, SPAN - 1);
+        const Tick at = _current + delta;
+
+        std::size_t level = 0;
+        while (level + 1 < LEVELS && (delta >> (SLOT_BITS * (level + 1))) != 0) {
+            ++level;
+        }
+
+        Level& target = _levels[level];
+        target.slots[(at >> (SLOT_BITS * level)) % SLOTS].push_back(entry);
+        ++target.size;
+    }
+
+    void _takeSlot(std::size_t level, Tick slot) {
+        _due.clear();
+        std::vector<Entry>& entries = _levels[level].slots[slot % SLOTS];
+        std::swap(_due, entries);
+        _levels[level].size -= _due.size();
+    }
+};
+
+}  // namespace AsyncTcpSock
+
+#endif
@@ -1,16 +1,19 @@
 #ifndef ASYNCTCPSOCK_WRITEQUEUEBUFFER_HPP
 #define ASYNCTCPSOCK_WRITEQUEUEBUFFER_HPP
 
+#include <algorithm>
+#include <array>
 #include <chrono>
+#include <cstddef>
 #include <cstdint>
+#include <memory>
+#include <span>
 #include <variant>
 #include <vector>
 
-#include <esp32-hal-log.h>
-#include <lwip/sockets.h>
-
 #include "Configuration.hpp"
-
+#include "ObjectPool.hpp"
+#include "Platform.hpp"
 
 namespace AsyncTcpSock {
 
@@ -34,7 +37,55 @@ struct OwnedWriteQueueBuffer : public CommonWriteQueueBuffer {
     std::vector<std::uint8_t> data{};
 };
 
-using WriteQueueBuffer = std::variant<BorrowedWriteQueueBuffer, OwnedWriteQueueBuffer>;
+/// Segment-sized storage for small copied writes, taken from a pool shared by all clients
+struct WriteChunk {
+    static constexpr std::size_t SIZE = Platform::MAX_SEGMENT_SIZE;
+
+    std::array<std::uint8_t, SIZE> bytes;
+
+    // Leaves the bytes uninitialized
+    WriteChunk() {
+    }
+
+    static ObjectPool<WriteChunk>& pool() {
+        // Never destroyed, chunks may outlive static destruction
+        static ObjectPool<WriteChunk>* pool =
+            new ObjectPool<WriteChunk>(CONFIG_ASYNC_TCP_WRITE_CHUNK_POOL_SIZE);
+        return *pool;
+    }
+
+    static void* operator new(std::size_t size) {
+        return ::operator new(size);
+    }
+
+    static void operator delete(void* ptr) {
+        pool().deallocate(ptr);
+    }
+};
+
+/// Consecutive small copied writes, appended to one chunk until it is full
+struct ChunkedWriteQueueBuffer : public CommonWriteQueueBuffer {
+    std::unique_ptr<WriteChunk> chunk{};
+    // The filled part of the chunk
+    std::span<const std::uint8_t> data{};
+
+    bool canAppend() const {
+        return errorCode == 0 && amountWritten < data.size() &&
+               data.size() < WriteChunk::SIZE;
+    }
+
+    /// Returns the number of bytes appended.
+    std::size_t append(std::span<const std::uint8_t> bytes) {
+        const std::size_t size = std::min(bytes.size(), WriteChunk::SIZE - data.size());
+        std::copy_n(bytes.begin(), size, chunk->bytes.begin() + data.size());
+        data = std::span(chunk->bytes.data(), data.size() + size);
+        return size;
+    }
+};
+
+using WriteQueueBuffer = std::variant<BorrowedWriteQueueBuffer,
+                                      OwnedWriteQueueBuffer,
+                                      ChunkedWriteQueueBuffer>;
 
 namespace WriteQueueBufferUtil {
 
@@ -51,46 +102,99 @@ inline bool isFullyWritten(const WriteQueueBuffer& buf) {
     return std::visit([](auto&& it) { return isFullyWritten_(it); }, buf);
 }
 
-inline std::size_t write(WriteQueueBuffer& buf, int socket) {
-    return std::visit(
-        [&](auto&& it) {
-            std::size_t writtenTotal = 0;
-
-            do {
-                const std::uint8_t* const start = it.data.data() + it.amountWritten;
-                const std::size_t toWrite = it.data.size() - it.amountWritten;
-
-                errno = 0;
-                const ssize_t result = lwip_write(socket, start, toWrite);
-
-                if (result >= 0) {
-                    log_d_("socket %d lwip_write() wrote %d bytes", socket, result);
-
-                    // Written some data into the socket
-                    it.amountWritten += result;
-                    writtenTotal += result;
+template <class Buffer>
+std::span<const std::uint8_t> unwritten_(const Buffer& buf) {
+    return std::span<const std::uint8_t>(buf.data).subspan(
+        std::min(buf.amountWritten, buf.data.size()));
+}
 
-                    if (isFullyWritten_(it)) {
-                        // We're done
-                        it.writtenAt = std::chrono::steady_clock::now();
+/// Write as much of the queued buffers as possible, gathering up to MAX_IOV buffers into
+/// each call to the socket. The queue must provide size() and operator[]. Stops at the
+/// first buffer with an error, a failed write is recorded in the first unwritten buffer.
+/// Returns the number of bytes written.
+template <class Queue>
+std::size_t writeAll(Queue& queue, int socket) {
+    static constexpr std::size_t MAX_IOV = 16;
+
+    std::size_t writtenTotal = 0;
+    std::size_t first = 0;
+
+    while (true) {
+        while (first < queue.size() && !hasError(queue[first]) &&
+               isFullyWritten(queue[first])) {
+            ++first;
+        }
+        if (first == queue.size() || hasError(queue[first])) {
+            break;
+        }
+
+        std::array<iovec, MAX_IOV> iov{};
+        std::size_t count = 0;
+        std::size_t requested = 0;
+        for (std::size_t i = first; i < queue.size() && count < iov.size(); ++i) {
+            if (hasError(queue[i])) {
+                break;
+            }
+
+            std::visit(
+                [&](auto&& it) {
+                    const std::span<const std::uint8_t> remaining = unwritten_(it);
+                    if (!remaining.empty()) {
+                        iov[count++] = iovec{
+                            .iov_base = const_cast<std::uint8_t*>(remaining.data()),
+                            .iov_len = remaining.size(),
+                        };
+                        requested += remaining.size();
+                    }
+                },
+                queue[i]);
+        }
+
+        errno = 0;
+        const ssize_t result = Platform::socketWritev(socket, iov.data(), count);
+
+        if (result < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                // Socket is full, could not write anything
+                log_w("socket %d is full", socket);
+            } else {
+                // A write error happened that should be reported
+                std::visit([&](auto&& it) { it.errorCode = errno; }, queue[first]);
+                log_e("socket %d write() failed errno=%d", socket, errno);
+            }
+            break;
+        }
+
+        log_d_("socket %d writev() wrote %zd bytes from %zu buffers", socket, result,
+               count);
+
+        // Distribute the progress over the buffers
+        const auto now = std::chrono::steady_clock::now();
+        std::size_t progress = result;
+        for (std::size_t i = first; i < queue.size() && progress > 0; ++i) {
+            std::visit(
+                [&](auto&& it) {
+                    const std::size_t written =
+                        std::min(progress, unwritten_(it).size());
+                    it.amountWritten += written;
+                    progress -= written;
+
+                    if (written > 0 && isFullyWritten_(it)) {
+                        it.writtenAt = now;
                         it.data = {};
-                        break;
                     }
-                } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
-                    // Socket is full, could not write anything
-                    log_w("socket %d is full", socket);
-                    break;
-                } else {
-                    // A write error happened that should be reported
-                    it.errorCode = errno;
-                    log_e("socket %d lwip_write() failed errno=%d", socket, it.errorCode);
-                    break;
-                }
-            } while (!isFullyWritten_(it));
-
-            return writtenTotal;
-        },
-        buf);
+                },
+                queue[i]);
+        }
+
+        writtenTotal += result;
+        if (static_cast<std::size_t>(result) < requested) {
+            // Socket is full
+            break;
+        }
+    }
+
+    return writtenTotal;
 }
 
 inline const CommonWriteQueueBuffer& asCommonView(const WriteQueueBuffer& buf) {
@@ -0,0 +1,180 @@
+#ifndef ASYNCTCPSOCK_PLATFORM_ESP32_HPP
+#define ASYNCTCPSOCK_PLATFORM_ESP32_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+#include <IPAddress.h>
+#include <esp32-hal-log.h>
+#include <esp32-hal.h>
+#include <esp_task_wdt.h>
+#include <freertos/idf_additions.h>
+#include <lwip/dns.h>
+#include <lwip/err.h>
+#include <lwip/ip_addr.h>
+#include <lwip/sockets.h>
+#include <portmacro.h>
+#include <sdkconfig.h>
+
+#ifdef EINPROGRESS
+#if EINPROGRESS != 119
+#error EINPROGRESS invalid
+#endif
+#endif
+
+namespace AsyncTcpSock::Platform {
+
+static constexpr std::size_t MAX_SEGMENT_SIZE = TCP_MSS;
+static constexpr std::size_t SEND_BUFFER_SIZE = TCP_SND_BUF;
+
+using TaskHandle = TaskHandle_t;
+
+inline unsigned coreCount() {
+    return portNUM_PROCESSORS;
+}
+
+inline bool createTask(void (*fn)(void*),
+                       const char* name,
+                       std::uint32_t stackSize,
+                       unsigned priority,
+                       int coreAffinity,
+                       void* arg,
+                       TaskHandle& handle) {
+    return xTaskCreateUniversal(fn, name, stackSize, arg, priority, &handle,
+                                coreAffinity) == pdPASS;
+}
+
+inline void deleteTask(TaskHandle& handle) {
+    if (handle != nullptr) {
+        vTaskDelete(handle);
+        handle = nullptr;
+    }
+}
+
+inline void enterWdt() {
+#if CONFIG_ASYNC_TCP_USE_WDT
+    if (esp_task_wdt_add(NULL) != ESP_OK) {
+        log_e("Failed to add async task to WDT");
+    }
+#endif
+}
+
+inline void leaveWdt() {
+#if CONFIG_ASYNC_TCP_USE_WDT
+    if (esp_task_wdt_delete(NULL) != ESP_OK) {
+        log_e("Failed to remove loop task from WDT");
+    }
+#endif
+}
+
+/// Let other tasks run while waiting for one of them. Unlike taskYIELD(), this includes
+/// tasks of lower priority.
+inline void yield() {
+    vTaskDelay(1);
+}
+
+enum class DnsStatus : std::uint8_t {
+    RESOLVED,
+    IN_PROGRESS,
+    FAILED,
+};
+
+/// Resolve host. If the address is known immediately, it is stored in resolved and
+/// RESOLVED is returned. Otherwise, Callback(const IPAddress* addresses, std::size_t
+/// count, void* arg) will be invoked from the LWIP thread once the lookup finishes,
+/// addresses being nullptr on failure. LWIP reports a single address.
+template <auto Callback>
+DnsStatus resolveHost(const char* host, IPAddress& resolved, void* arg) {
+    ip_addr_t addr;
+    err_t err = dns_gethostbyname(
+        host, &addr,
+        [](const char*, const ip_addr_t* ip, void* arg) {
+            if (ip) {
+                IPAddress address;
+                address.from_ip_addr_t(ip);
+                Callback(&address, 1, arg);
+            } else {
+                Callback(nullptr, 0, arg);
+            }
+        },
+        arg);
+
+    if (err == ERR_OK) {
+        resolved = IPAddress(&addr);
+        return DnsStatus::RESOLVED;
+    } else if (err == ERR_INPROGRESS) {
+        return DnsStatus::IN_PROGRESS;
+    }
+
+    log_e("dns_gethostbyname() error: %d", err);
+    return DnsStatus::FAILED;
+}
+
+/// Whether the non-blocking connect() of the socket has finished, without waiting.
+/// error is then 0 if it succeeded.
+inline bool connectFinished(int socket, int& error) {
+    fd_set writable;
+    FD_ZERO(&writable);
+    FD_SET(socket, &writable);
+    timeval timeout{.tv_sec = 0, .tv_usec = 0};
+    if (lwip_select(socket + 1, nullptr, &writable, nullptr, &timeout) <= 0) {
+        return false;
+    }
+
+    socklen_t errorSize = sizeof(error);
+    if (lwip_getsockopt(socket, SOL_SOCKET, SO_ERROR, &error, &errorSize) < 0) {
+        error = errno;
+    }
+    return true;
+}
+
+inline ssize_t socketRead(int socket, void* data, std::size_t size) {
+    return lwip_read(socket, data, size);
+}
+
+/// Copy received data without consuming it. Doesn't block on non-blocking sockets.
+inline ssize_t socketPeek(int socket, void* data, std::size_t size) {
+    return lwip_recv(socket, data, size, MSG_PEEK);
+}
+
+inline ssize_t socketWrite(int socket, const void* data, std::size_t size) {
+    return lwip_write(socket, data, size);
+}
+
+inline ssize_t socketWritev(int socket, const iovec* iov, int count) {
+    return lwip_writev(socket, iov, count);
+}
+
+/// Free space in the send buffer of the socket, 0 if unknown. LWIP doesn't expose it
+/// through the socket API.
+inline std::size_t socketSendSpace(int) {
+    return 0;
+}
+
+/// Whether a write to the socket wouldn't block, without waiting. LWIP's descriptors all
+/// fit into an fd_set.
+inline bool socketWritable(int socket) {
+    fd_set writable;
+    FD_ZERO(&writable);
+    FD_SET(socket, &writable);
+    timeval timeout{.tv_sec = 0, .tv_usec = 0};
+    return lwip_select(socket + 1, nullptr, &writable, nullptr, &timeout) > 0;
+}
+
+/// Accept a connection and make its socket non-blocking.
+inline int acceptNonBlocking(int socket, sockaddr* addr, socklen_t* addrSize) {
+    const int accepted = lwip_accept(socket, addr, addrSize);
+    // O_NONBLOCK is the only flag LWIP knows, so there is nothing to preserve
+    if (accepted >= 0 && lwip_fcntl(accepted, F_SETFL, O_NONBLOCK) < 0) {
+        const int error = errno;
+        lwip_close(accepted);
+        errno = error;
+        return -1;
+    }
+
+    return accepted;
+}
+
+}  // namespace AsyncTcpSock::Platform
+
+#endif
@@ -0,0 +1,468 @@
+#ifndef ASYNCTCPSOCK_PLATFORM_POSIX_HPP
+#define ASYNCTCPSOCK_PLATFORM_POSIX_HPP
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <sys/ioctl.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "../Configuration.hpp"
+
+//
+// Logging, mirroring the format of esp32-hal-log.h
+//
+#ifndef ASYNC_TCP_POSIX_LOG_LEVEL
+// 0: none, 1: error, 2: warning, 3: info, 4: debug, 5: verbose
+#define ASYNC_TCP_POSIX_LOG_LEVEL 2
+#endif
+
+#define ASYNC_TCP_POSIX_LOG(level, letter, format, ...)                              \
+    do {                                                                              \
+        if constexpr ((level) <= ASYNC_TCP_POSIX_LOG_LEVEL) {                         \
+            std::fprintf(stderr, "[" letter "][%s:%d] %s(): " format "\n", __FILE__,  \
+                         __LINE__, __func__ __VA_OPT__(, ) __VA_ARGS__);              \
+        }                                                                             \
+    } while (0)
+
+#ifndef log_e
+#define log_e(format, ...) ASYNC_TCP_POSIX_LOG(1, "E", format __VA_OPT__(, ) __VA_ARGS__)
+#endif
+#ifndef log_w
+#define log_w(format, ...) ASYNC_TCP_POSIX_LOG(2, "W", format __VA_OPT__(, ) __VA_ARGS__)
+#endif
+#ifndef log_i
+#define log_i(format, ...) ASYNC_TCP_POSIX_LOG(3, "I", format __VA_OPT__(, ) __VA_ARGS__)
+#endif
+#ifndef log_d
+#define log_d(format, ...) ASYNC_TCP_POSIX_LOG(4, "D", format __VA_OPT__(, ) __VA_ARGS__)
+#endif
+#ifndef log_v
+#define log_v(format, ...) ASYNC_TCP_POSIX_LOG(5, "V", format __VA_OPT__(, ) __VA_ARGS__)
+#endif
+
+//
+// LWIP error codes, see lwip/err.h
+//
+typedef std::int8_t err_t;
+
+enum err_enum_t {
+    ERR_OK = 0,
+    ERR_MEM = -1,
+    ERR_BUF = -2,
+    ERR_TIMEOUT = -3,
+    ERR_RTE = -4,
+    ERR_INPROGRESS = -5,
+    ERR_VAL = -6,
+    ERR_WOULDBLOCK = -7,
+    ERR_USE = -8,
+    ERR_ALREADY = -9,
+    ERR_ISCONN = -10,
+    ERR_CONN = -11,
+    ERR_IF = -12,
+    ERR_ABRT = -13,
+    ERR_RST = -14,
+    ERR_CLSD = -15,
+    ERR_ARG = -16,
+};
+
+//
+// Subset of Arduino's IPAddress used by the library
+//
+enum IPType {
+    IPv4,
+    IPv6,
+};
+
+class IPAddress {
+    // Network byte order. IPv4 addresses are stored in the last four bytes.
+    std::array<std::uint8_t, 16> _address{};
+    std::uint8_t _zone = 0;
+    IPType _type = IPv4;
+
+  public:
+    IPAddress() = default;
+
+    IPAddress(std::uint32_t address) {
+        std::memcpy(&_address[12], &address, sizeof(address));
+    }
+
+    IPAddress(std::uint8_t a, std::uint8_t b, std::uint8_t c, std::uint8_t d) {
+        _address[12] = a;
+        _address[13] = b;
+        _address[14] = c;
+        _address[15] = d;
+    }
+
+    IPAddress(IPType type, const std::uint8_t* address, std::uint8_t zone = 0)
+        : _zone(zone), _type(type) {
+        if (type == IPv6) {
+            std::memcpy(_address.data(), address, 16);
+        } else {
+            std::memcpy(&_address[12], address, 4);
+        }
+    }
+
+    IPType type() const {
+        return _type;
+    }
+
+    std::uint8_t zone() const {
+        return _zone;
+    }
+
+    /// Bytes in network order, the four of an IPv4 address or the sixteen of IPv6
+    std::uint8_t operator[](int index) const {
+        return _type == IPv4 ? _address[12 + index] : _address[index];
+    }
+
+    operator std::uint32_t() const {
+        if (_type != IPv4) {
+            return 0;
+        }
+
+        std::uint32_t address;
+        std::memcpy(&address, &_address[12], sizeof(address));
+        return address;
+    }
+
+    explicit operator bool() const {
+        for (std::uint8_t b : _address) {
+            if (b != 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool operator==(const IPAddress& other) const = default;
+
+    std::string toString() const {
+        std::array<char, INET6_ADDRSTRLEN> buffer{};
+        if (_type == IPv6) {
+            inet_ntop(AF_INET6, _address.data(), buffer.data(), buffer.size());
+        } else {
+            inet_ntop(AF_INET, &_address[12], buffer.data(), buffer.size());
+        }
+        return buffer.data();
+    }
+};
+
+namespace AsyncTcpSock::Platform {
+
+// Same shape as the LWIP defaults on the ESP32
+static constexpr std::size_t MAX_SEGMENT_SIZE = 1460;
+static constexpr std::size_t SEND_BUFFER_SIZE = 4 * MAX_SEGMENT_SIZE;
+
+using TaskHandle = std::thread;
+
+inline unsigned coreCount() {
+    return std::max(1u, std::thread::hardware_concurrency());
+}
+
+/// Core affinity and priority are ignored, the stack size is left to the OS.
+inline bool createTask(void (*fn)(void*),
+                       const char*,
+                       std::uint32_t,
+                       unsigned,
+                       int,
+                       void* arg,
+                       TaskHandle& handle) {
+    try {
+        handle = std::thread(fn, arg);
+    } catch (const std::system_error& e) {
+        log_e("std::thread creation failed: %s", e.what());
+        return false;
+    }
+
+    return true;
+}
+
+/// Unlike vTaskDelete(), this can't kill the task. The task function must have been
+/// told to return before calling this.
+inline void deleteTask(TaskHandle& handle) {
+    if (handle.joinable()) {
+        handle.join();
+    }
+}
+
+inline void enterWdt() {
+}
+
+inline void leaveWdt() {
+}
+
+/// Let other threads run while waiting for one of them.
+inline void yield() {
+    std::this_thread::yield();
+}
+
+enum class DnsStatus : std::uint8_t {
+    RESOLVED,
+    IN_PROGRESS,
+    FAILED,
+};
+
+/// Threads running the blocking getaddrinfo() calls of resolveHost(), started on first
+/// use. Lookups of different hosts run in parallel up to the number of threads.
+class ResolverPool {
+  public:
+    using Callback = void (*)(const IPAddress* addresses, std::size_t count, void* arg);
+
+  private:
+    struct Lookup {
+        std::string host;
+        Callback callback;
+        void* arg;
+    };
+
+    std::mutex _mutex{};
+    std::condition_variable _available{};
+    std::deque<Lookup> _lookups{};
+    std::size_t _threads = 0;
+    std::size_t _idle = 0;
+    const std::size_t _maxThreads;
+
+  public:
+    explicit ResolverPool(std::size_t maxThreads)
+        : _maxThreads(std::max<std::size_t>(maxThreads, 1)) {
+    }
+
+    /// Never destroyed, lookups may still be running at exit
+    static ResolverPool& instance() {
+        static ResolverPool* pool = new ResolverPool(CONFIG_ASYNC_TCP_DNS_THREADS);
+        return *pool;
+    }
+
+    /// Returns false if no thread could be started to run the lookup
+    bool submit(const char* host, Callback callback, void* arg) {
+        std::lock_guard lock(_mutex);
+        _lookups.push_back(Lookup{host, callback, arg});
+        if (_idle == 0 && _threads < _maxThreads) {
+            try {
+                std::thread(&ResolverPool::_run, this).detach();
+                ++_threads;
+            } catch (const std::system_error& e) {
+                log_e("resolver thread creation failed: %s", e.what());
+                if (_threads == 0) {
+                    _lookups.pop_back();
+                    return false;
+                }
+            }
+        }
+        _available.notify_one();
+        return true;
+    }
+
+  private:
+    void _run() {
+        std::unique_lock lock(_mutex);
+        while (true) {
+            ++_idle;
+            _available.wait(lock, [&] { return !_lookups.empty(); });
+            --_idle;
+
+            const Lookup lookup = std::move(_lookups.front());
+            _lookups.pop_front();
+            lock.unlock();
+
+            const std::vector<IPAddress> resolved = _resolve(lookup.host.c_str());
+            lookup.callback(resolved.empty() ? nullptr : resolved.data(),
+                            resolved.size(), lookup.arg);
+
+            lock.lock();
+        }
+    }
+
+    // Addresses of both families, only those configured on the host. getaddrinfo()
+    // sorts them by preference (RFC 6724), they are then interleaved by family starting
+    // with the preferred one, as RFC 8305 recommends.
+    static std::vector<IPAddress> _resolve(const char* host) {
+        addrinfo hints{};
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        hints.ai_flags = AI_ADDRCONFIG;
+
+        addrinfo* result = nullptr;
+        int err = getaddrinfo(host, nullptr, &hints, &result);
+        if (err != 0 || result == nullptr) {
+            log_e("getaddrinfo() error for %s: %d (%s)", host, err, gai_strerror(err));
+            return {};
+        }
+
+        std::vector<IPAddress> preferred;
+        std::vector<IPAddress> other;
+        const int preferredFamily = result->ai_family;
+        for (const addrinfo* info = result; info != nullptr; info = info->ai_next) {
+            IPAddress address;
+            if (info->ai_family == AF_INET6) {
+                sockaddr_in6 addr;
+                std::memcpy(&addr, info->ai_addr, sizeof(addr));
+                if (addr.sin6_scope_id > 0xFF) {
+                    // The zone of IPAddress can't tell the interface
+                    log_w("Skipping address of %s on interface %u", host,
+                          addr.sin6_scope_id);
+                    continue;
+                }
+                address = IPAddress(IPv6, addr.sin6_addr.s6_addr,
+                                    static_cast<std::uint8_t>(addr.sin6_scope_id));
+            } else if (info->ai_family == AF_INET) {
+                sockaddr_in addr;
+                std::memcpy(&addr, info->ai_addr, sizeof(addr));
+                address = IPAddress(addr.sin_addr.s_addr);
+            } else {
+                continue;
+            }
+
+            std::vector<IPAddress>& family =
+                info->ai_family == preferredFamily ? preferred : other;
+            if (std::find(family.begin(), family.end(), address) == family.end()) {
+                family.push_back(address);
+            }
+        }
+        freeaddrinfo(result);
+
+        std::vector<IPAddress> resolved;
+        for (std::size_t i = 0; i < std::max(preferred.size(), other.size()); ++i) {
+            if (i < preferred.size()) {
+                resolved.push_back(preferred[i]);
+            }
+            if (i < other.size()) {
+                resolved.push_back(other[i]);
+            }
+        }
+        return resolved;
+    }
+};
+
+/// Resolve host. Numeric addresses are stored in resolved and RESOLVED is returned.
+/// Otherwise, getaddrinfo() runs on the ResolverPool and Callback(const IPAddress*
+/// addresses, std::size_t count, void* arg) is invoked from one of its threads with the
+/// addresses in the order they should be tried, addresses being nullptr on failure.
+template <auto Callback>
+DnsStatus resolveHost(const char* host, IPAddress& resolved, void* arg) {
+    in_addr numeric{};
+    if (inet_pton(AF_INET, host, &numeric) == 1) {
+        resolved = IPAddress(numeric.s_addr);
+        return DnsStatus::RESOLVED;
+    }
+    in6_addr numeric6{};
+    if (inet_pton(AF_INET6, host, &numeric6) == 1) {
+        resolved = IPAddress(IPv6, numeric6.s6_addr);
+        return DnsStatus::RESOLVED;
+    }
+
+    const bool submitted = ResolverPool::instance().submit(
+        host,
+        [](const IPAddress* addresses, std::size_t count, void* arg) {
+            Callback(addresses, count, arg);
+        },
+        arg);
+    return submitted ? DnsStatus::IN_PROGRESS : DnsStatus::FAILED;
+}
+
+/// Whether the non-blocking connect() of the socket has finished, without waiting.
+/// error is then 0 if it succeeded.
+inline bool connectFinished(int socket, int& error) {
+    pollfd fd{.fd = socket, .events = POLLOUT, .revents = 0};
+    if (::poll(&fd, 1, 0) == 0) {
+        return false;
+    }
+
+    socklen_t errorSize = sizeof(error);
+    if (getsockopt(socket, SOL_SOCKET, SO_ERROR, &error, &errorSize) < 0) {
+        error = errno;
+    }
+    return true;
+}
+
+inline ssize_t socketRead(int socket, void* data, std::size_t size) {
+    return ::recv(socket, data, size, 0);
+}
+
+/// Copy received data without consuming it. Doesn't block on non-blocking sockets.
+inline ssize_t socketPeek(int socket, void* data, std::size_t size) {
+    return ::recv(socket, data, size, MSG_PEEK);
+}
+
+inline ssize_t socketWrite(int socket, const void* data, std::size_t size) {
+    // Report EPIPE instead of raising SIGPIPE when the peer has gone away, like LWIP
+    return ::send(socket, data, size, MSG_NOSIGNAL);
+}
+
+inline ssize_t socketWritev(int socket, const iovec* iov, int count) {
+    msghdr message{};
+    message.msg_iov = const_cast<iovec*>(iov);
+    message.msg_iovlen = count;
+    return ::sendmsg(socket, &message, MSG_NOSIGNAL);
+}
+
+/// Free space in the send buffer of the socket, 0 if unknown.
+inline std::size_t socketSendSpace(int socket) {
+    int capacity = 0;
+    socklen_t capacitySize = sizeof(capacity);
+    int queued = 0;
+    // TIOCOUTQ is SIOCOUTQ for sockets: bytes not yet acknowledged by the peer
+    if (getsockopt(socket, SOL_SOCKET, SO_SNDBUF, &capacity, &capacitySize) < 0 ||
+        ioctl(socket, TIOCOUTQ, &queued) < 0) {
+        return 0;
+    }
+
+#ifdef __linux__
+    // Linux reports twice the size that was set, to account for its bookkeeping
+    capacity /= 2;
+#endif
+    return capacity > queued ? capacity - queued : 0;
+}
+
+/// Whether a write to the socket wouldn't block, without waiting. poll() rather than
+/// select(), which can't take descriptors of FD_SETSIZE or more.
+inline bool socketWritable(int socket) {
+    pollfd fd{.fd = socket, .events = POLLOUT, .revents = 0};
+    return ::poll(&fd, 1, 0) > 0;
+}
+
+/// Accept a connection and make its socket non-blocking.
+inline int acceptNonBlocking(int socket, sockaddr* addr, socklen_t* addrSize) {
+#ifdef SOCK_NONBLOCK
+    return ::accept4(socket, addr, addrSize, SOCK_NONBLOCK | SOCK_CLOEXEC);
+#else
+    const int accepted = ::accept(socket, addr, addrSize);
+    if (accepted >= 0 &&
+        fcntl(accepted, F_SETFL, fcntl(accepted, F_GETFL, 0) | O_NONBLOCK) < 0) {
+        const int error = errno;
+        ::close(accepted);
+        errno = error;
+        return -1;
+    }
+
+    return accepted;
+#endif
+}
+
+}  // namespace AsyncTcpSock::Platform
+
+#endif
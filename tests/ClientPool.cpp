@@ -0,0 +1,183 @@
+// ClientPool against a plain socket server: a released client is handed out again,
+// without losing what the peer sends before the new user has installed its handlers, one
+// the peer closed while it was idle is not, and idle clients beyond the cap or past their
+// age are closed.
+//
+// The server side accepts on the test's thread and checks through its end of each
+// connection whether the pool closed the client.
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <AsyncTCP.h>
+
+using namespace std::chrono_literals;
+
+namespace {
+
+constexpr const char* HOST = "127.0.0.1";
+constexpr std::uint16_t PORT = 47103;
+
+std::atomic<std::size_t> failures = 0;
+
+#define CHECK(condition)                                                           \
+    do {                                                                           \
+        if (!(condition)) {                                                        \
+            std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, \
+                         #condition);                                              \
+            ++failures;                                                            \
+        }                                                                          \
+    } while (false)
+
+template <class Predicate>
+bool waitFor(Predicate&& predicate, std::chrono::steady_clock::duration timeout = 10s) {
+    const auto deadline = std::chrono::steady_clock::now() + timeout;
+    while (!predicate()) {
+        if (std::chrono::steady_clock::now() > deadline) {
+            return false;
+        }
+        std::this_thread::sleep_for(1ms);
+    }
+    return true;
+}
+
+// Connects a client fresh from the pool and returns the server's end, -1 on failure
+int connectNew(AsyncClient* client, int listener) {
+    CHECK(!client->connected());
+    if (!client->connect(HOST, PORT)) {
+        return -1;
+    }
+    const int peer = accept(listener, nullptr, nullptr);
+    if (peer < 0 || !waitFor([&] { return client->connected(); })) {
+        return -1;
+    }
+    const timeval timeout{.tv_sec = 2, .tv_usec = 0};
+    setsockopt(peer, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    return peer;
+}
+
+// Whether the client's side of the connection was closed
+bool closedByClient(int peer) {
+    char byte;
+    return recv(peer, &byte, sizeof(byte), 0) == 0;
+}
+
+// Keeps the first byte of what the client receives
+void receiveInto(AsyncClient* client, std::atomic<char>& received) {
+    client->onData([&received](void*, AsyncClient*, void* data, std::size_t size) {
+        if (size > 0) {
+            received = *static_cast<const char*>(data);
+        }
+    });
+}
+
+void testReuse(AsyncClientPool& pool, int listener) {
+    std::atomic<char> received = 0;
+    AsyncClient* client = pool.acquire(HOST, PORT);
+    receiveInto(client, received);
+    const int peer = connectNew(client, listener);
+    CHECK(peer >= 0);
+    if (peer < 0) {
+        return;
+    }
+    char byte = 'a';
+    send(peer, &byte, sizeof(byte), MSG_NOSIGNAL);
+    CHECK(waitFor([&] { return received.load() == 'a'; }));
+
+    // The handlers are cleared on the manager task
+    pool.release(client);
+    CHECK(waitFor([&] { return pool.idle() == 1; }));
+
+    AsyncClient* reused = pool.acquire(HOST, PORT);
+    CHECK(reused == client);
+    CHECK(reused->connected());
+    CHECK(pool.idle() == 0);
+
+    // Sent before the handlers are installed, kept until reading is resumed
+    byte = 'b';
+    send(peer, &byte, sizeof(byte), MSG_NOSIGNAL);
+    std::this_thread::sleep_for(50ms);
+    receiveInto(reused, received);
+    reused->setReadPaused(false);
+    CHECK(waitFor([&] { return received.load() == 'b'; }));
+
+    // Closed by the peer while idle
+    pool.release(reused);
+    CHECK(waitFor([&] { return pool.idle() == 1; }));
+    ::close(peer);
+    std::this_thread::sleep_for(50ms);
+
+    AsyncClient* fresh = pool.acquire(HOST, PORT);
+    CHECK(!fresh->connected());
+    CHECK(pool.idle() == 0);
+    pool.discard(fresh);
+}
+
+void testLimits(AsyncClientPool& pool, int listener) {
+    pool.setMaxIdle(1);
+
+    AsyncClient* first = pool.acquire(HOST, PORT);
+    const int firstPeer = connectNew(first, listener);
+    AsyncClient* second = pool.acquire(HOST, PORT);
+    const int secondPeer = connectNew(second, listener);
+    CHECK(firstPeer >= 0 && secondPeer >= 0);
+    if (firstPeer < 0 || secondPeer < 0) {
+        return;
+    }
+
+    // Beyond the cap, the oldest idle client is closed
+    pool.release(first);
+    CHECK(waitFor([&] { return pool.idle() == 1; }));
+    pool.release(second);
+    CHECK(closedByClient(firstPeer));
+    CHECK(pool.idle() == 1);
+
+    // Too old
+    pool.setMaxIdleAge(100ms);
+    std::this_thread::sleep_for(150ms);
+    pool.prune();
+    CHECK(pool.idle() == 0);
+    CHECK(closedByClient(secondPeer));
+
+    ::close(firstPeer);
+    ::close(secondPeer);
+}
+
+}  // namespace
+
+int main() {
+    const int listener = socket(AF_INET, SOCK_STREAM, 0);
+    const int reuse = 1;
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    const sockaddr_in addr{.sin_family = AF_INET,
+                           .sin_port = htons(PORT),
+                           .sin_addr = {.s_addr = htonl(INADDR_LOOPBACK)},
+                           .sin_zero = {}};
+    if (bind(listener, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) < 0 ||
+        listen(listener, 8) < 0) {
+        std::printf("failed to listen on port %u\n", PORT);
+        return 1;
+    }
+
+    {
+        AsyncClientPool pool;
+        testReuse(pool, listener);
+        testLimits(pool, listener);
+    }
+    // The manager task deletes the clients
+    std::this_thread::sleep_for(100ms);
+    ::close(listener);
+
+    if (failures > 0) {
+        std::printf("%zu checks failed\n", failures.load());
+        return 1;
+    }
+    std::printf("passed\n");
+    return 0;
+}
@@ -0,0 +1,279 @@
+// ConnectionRegistry on its own: the basic operations on one thread, then writers adding
+// and removing connections while other threads look them up, iterate and signal them.
+// The registry is small, so slots are reused by all writers with changing generations.
+//
+// Each connection is added once under a handle that the writer publishes afterwards.
+// Lookups must return either nothing or exactly that connection, and nothing once a newer
+// one has been published.
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <optional>
+#include <random>
+#include <thread>
+#include <variant>
+#include <vector>
+
+#include <ConnectionRegistry.hpp>
+
+using namespace AsyncTcpSock;
+
+namespace {
+
+std::atomic<std::size_t> failures = 0;
+
+#define CHECK(condition)                                                           \
+    do {                                                                           \
+        if (!(condition)) {                                                        \
+            std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, \
+                         #condition);                                              \
+            ++failures;                                                            \
+        }                                                                          \
+    } while (false)
+
+struct Entry {
+    // Handle the entry was added under, 0 until add() returned
+    std::atomic<std::uint64_t> handle{0};
+};
+
+struct Other {};
+
+using Variant = std::variant<std::monostate, Entry*, Other*>;
+using Registry = ConnectionRegistry<Variant>;
+
+Entry* entryOf(const Variant& connection) {
+    const auto* entry = std::get_if<Entry*>(&connection);
+    return entry != nullptr ? *entry : nullptr;
+}
+
+void testSingleThreaded() {
+    Registry registry(40);
+    Entry first;
+    Other other;
+
+    const std::optional<ConnectionHandle> handle = registry.add(&first);
+    CHECK(handle && handle->isValid());
+    CHECK(entryOf(registry.get(*handle)) == &first);
+    CHECK(registry.size() == 1);
+
+    const std::optional<ConnectionHandle> otherHandle = registry.add(&other);
+    CHECK(otherHandle && std::get<Other*>(registry.get(*otherHandle)) == &other);
+
+    // A freed slot is reused with a new generation, the old handle stays dead
+    registry.remove(*handle);
+    CHECK(registry.get(*handle).index() == 0);
+    Entry second;
+    const std::optional<ConnectionHandle> reused = registry.add(&second);
+    CHECK(reused && reused->slot == handle->slot);
+    CHECK(reused && reused->generation != handle->generation);
+    CHECK(registry.get(*handle).index() == 0);
+    CHECK(entryOf(registry.get(*reused)) == &second);
+
+    // Removing with a stale handle doesn't touch the new connection
+    registry.remove(*handle);
+    CHECK(entryOf(registry.get(*reused)) == &second);
+    CHECK(registry.size() == 2);
+
+    // Signals are merged until taken and dropped for removed connections
+    registry.signal(*reused, 0x01);
+    registry.signal(*reused, 0x04);
+    registry.signal(*otherHandle, 0x02);
+    registry.signal(*handle, 0x08);
+    CHECK(registry.hasSignaled());
+    std::size_t taken = 0;
+    registry.takeSignaled([&](ConnectionHandle h, const Variant& connection,
+                              std::uint8_t flags) {
+        ++taken;
+        if (h == *reused) {
+            CHECK(entryOf(connection) == &second);
+            CHECK(flags == 0x05);
+        } else {
+            CHECK(h == *otherHandle);
+            CHECK(flags == 0x02);
+        }
+    });
+    CHECK(taken == 2);
+    CHECK(!registry.hasSignaled());
+
+    registry.signal(*otherHandle, 0x01);
+    registry.remove(*otherHandle);
+    taken = 0;
+    registry.takeSignaled(
+        [&](ConnectionHandle, const Variant&, std::uint8_t) { ++taken; });
+    CHECK(taken == 0);
+
+    // Full once every slot is taken
+    std::vector<Entry> entries(40);
+    std::size_t added = 1;
+    for (Entry& entry : entries) {
+        added += registry.add(&entry).has_value();
+    }
+    CHECK(added == 40);
+    CHECK(registry.size() == 40);
+
+    std::size_t visited = 0;
+    registry.forEach([&](ConnectionHandle h, const Variant& connection) {
+        ++visited;
+        CHECK(registry.get(h).index() == connection.index());
+    });
+    CHECK(visited == 40);
+}
+
+void testConcurrent() {
+    constexpr std::size_t WRITERS = 4;
+    constexpr std::size_t ADDS = 200000;
+    // Two chunks, shared by all writers
+    Registry registry(64);
+
+    // Per writer, every entry ever added and the index of the latest one. Entries before
+    // the latest have been removed.
+    std::vector<std::unique_ptr<Entry[]>> logs;
+    std::vector<std::atomic<std::size_t>> latest(WRITERS);
+    for (std::size_t i = 0; i < WRITERS; ++i) {
+        logs.push_back(std::make_unique<Entry[]>(ADDS));
+    }
+    // Per writer, a few long-lived connections that stay put while the others churn.
+    // Readers may still look at them after their writer is done.
+    std::vector<std::array<Entry, 2>> pinned(WRITERS);
+
+    std::atomic<std::size_t> writersDone = 0;
+    std::vector<std::thread> threads;
+
+    for (std::size_t w = 0; w < WRITERS; ++w) {
+        threads.emplace_back([&, w]() {
+            std::array<ConnectionHandle, 2> pinnedHandles;
+            for (std::size_t i = 0; i < pinned[w].size(); ++i) {
+                pinnedHandles[i] = registry.add(&pinned[w][i]).value();
+            }
+
+            for (std::size_t i = 0; i < ADDS; ++i) {
+                Entry& entry = logs[w][i];
+                const std::optional<ConnectionHandle> handle = registry.add(&entry);
+                CHECK(handle.has_value());
+                if (!handle) {
+                    break;
+                }
+                entry.handle.store(handle->pack(), std::memory_order_relaxed);
+                latest[w].store(i, std::memory_order_release);
+
+                CHECK(entryOf(registry.get(*handle)) == &entry);
+                registry.remove(*handle);
+                CHECK(registry.get(*handle).index() == 0);
+            }
+
+            for (std::size_t i = 0; i < pinned[w].size(); ++i) {
+                CHECK(entryOf(registry.get(pinnedHandles[i])) == &pinned[w][i]);
+                registry.remove(pinnedHandles[i]);
+            }
+            ++writersDone;
+        });
+    }
+
+    const auto running = [&]() { return writersDone.load() < WRITERS; };
+
+    // Looks up the latest and older handles of random writers
+    for (std::size_t r = 0; r < 2; ++r) {
+        threads.emplace_back([&, r]() {
+            std::minstd_rand random(r);
+            while (running()) {
+                const std::size_t w = random() % WRITERS;
+                const std::size_t newest = latest[w].load(std::memory_order_acquire);
+                const std::size_t i =
+                    random() % 2 == 0 ? newest : random() % (newest + 1);
+                Entry& entry = logs[w][i];
+                const std::uint64_t packed = entry.handle.load(std::memory_order_relaxed);
+                if (packed == 0) {
+                    continue;
+                }
+
+                const Variant connection = registry.get(ConnectionHandle::unpack(packed));
+                if (i < newest) {
+                    CHECK(connection.index() == 0);
+                } else {
+                    CHECK(connection.index() == 0 || entryOf(connection) == &entry);
+                }
+            }
+        });
+    }
+
+    // Every connection found by forEach must be the one added under that handle
+    threads.emplace_back([&]() {
+        while (running()) {
+            registry.forEach([&](ConnectionHandle handle, const Variant& connection) {
+                const Entry* entry = entryOf(connection);
+                CHECK(entry != nullptr);
+                if (entry == nullptr) {
+                    return;
+                }
+                const std::uint64_t packed =
+                    entry->handle.load(std::memory_order_relaxed);
+                CHECK(packed == 0 || packed == handle.pack());
+            });
+        }
+    });
+
+    // Signals published handles, which are often already removed or reused
+    std::atomic<bool> signalerDone = false;
+    threads.emplace_back([&]() {
+        std::minstd_rand random(42);
+        while (running()) {
+            const std::size_t w = random() % WRITERS;
+            const std::size_t i = latest[w].load(std::memory_order_acquire);
+            const std::uint64_t packed =
+                logs[w][i].handle.load(std::memory_order_relaxed);
+            if (packed != 0) {
+                registry.signal(ConnectionHandle::unpack(packed), 1u << (random() % 8));
+            }
+        }
+        signalerDone = true;
+    });
+
+    // Single consumer of the signals
+    std::size_t signaled = 0;
+    threads.emplace_back([&]() {
+        const auto take = [&]() {
+            registry.takeSignaled([&](ConnectionHandle handle, const Variant& connection,
+                                      std::uint8_t flags) {
+                ++signaled;
+                CHECK(flags != 0);
+                const Entry* entry = entryOf(connection);
+                CHECK(entry != nullptr);
+                if (entry != nullptr) {
+                    CHECK(entry->handle.load(std::memory_order_relaxed) == handle.pack());
+                }
+            });
+        };
+        while (!signalerDone) {
+            take();
+        }
+        take();
+    });
+
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+
+    CHECK(registry.size() == 0);
+    CHECK(!registry.hasSignaled());
+    std::size_t remaining = 0;
+    registry.forEach([&](ConnectionHandle, const Variant&) { ++remaining; });
+    CHECK(remaining == 0);
+    std::printf("%zu signaled connections taken\n", signaled);
+}
+
+}  // namespace
+
+int main() {
+    testSingleThreaded();
+    testConcurrent();
+
+    if (failures > 0) {
+        std::printf("%zu checks failed\n", failures.load());
+        return 1;
+    }
+    std::printf("passed\n");
+    return 0;
+}
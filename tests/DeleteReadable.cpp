@@ -0,0 +1,178 @@
+// Clients deleted by the application while the worker task is delivering their data. A
+// plain socket server on another thread floods every connection, so the clients are
+// readable whenever they are deleted, and onData takes a while to widen the window.
+//
+// Once delete has returned, the worker task must neither be inside nor enter a callback
+// of the client. The socket must not be closed under a running callback either, nor may
+// the worker read a closed socket and report an error for it. The server never closes
+// first, so neither happens legitimately.
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <AsyncTCP.h>
+
+using namespace std::chrono_literals;
+
+namespace {
+
+constexpr std::uint16_t PORT = 47101;
+constexpr std::size_t ROUNDS = 200;
+constexpr std::size_t CLIENTS = 16;
+
+struct ClientState {
+    std::atomic<bool> inCallback = false;
+    std::atomic<bool> deleted = false;
+    std::atomic<bool> receiving = false;
+};
+
+std::atomic<std::size_t> callbacksAfterDelete = 0;
+std::atomic<std::size_t> closedDuringCallback = 0;
+std::atomic<std::size_t> errors = 0;
+std::atomic<std::size_t> dataCallbacks = 0;
+
+template <class Predicate>
+bool waitFor(Predicate&& predicate, std::chrono::steady_clock::duration timeout = 10s) {
+    const auto deadline = std::chrono::steady_clock::now() + timeout;
+    while (!predicate()) {
+        if (std::chrono::steady_clock::now() > deadline) {
+            return false;
+        }
+        std::this_thread::sleep_for(100us);
+    }
+    return true;
+}
+
+// Accepts connections and writes to all of them as fast as they take it
+void flood(int listener, const std::atomic<bool>& stop) {
+    static constexpr char payload[4096] = {};
+    std::vector<int> peers;
+    while (!stop) {
+        const int peer = accept(listener, nullptr, nullptr);
+        if (peer >= 0) {
+            fcntl(peer, F_SETFL, fcntl(peer, F_GETFL, 0) | O_NONBLOCK);
+            peers.push_back(peer);
+        }
+
+        bool wrote = false;
+        for (auto it = peers.begin(); it != peers.end();) {
+            const ssize_t result = send(*it, payload, sizeof(payload), MSG_NOSIGNAL);
+            if (result < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+                ::close(*it);
+                it = peers.erase(it);
+                continue;
+            }
+            wrote |= result > 0;
+            ++it;
+        }
+        if (!wrote && peer < 0) {
+            std::this_thread::sleep_for(50us);
+        }
+    }
+
+    for (int peer : peers) {
+        ::close(peer);
+    }
+}
+
+}  // namespace
+
+int main() {
+    const int listener = socket(AF_INET, SOCK_STREAM, 0);
+    const int reuse = 1;
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    const sockaddr_in addr{.sin_family = AF_INET,
+                           .sin_port = htons(PORT),
+                           .sin_addr = {.s_addr = htonl(INADDR_LOOPBACK)},
+                           .sin_zero = {}};
+    if (bind(listener, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) < 0 ||
+        listen(listener, 128) < 0) {
+        std::printf("failed to listen on port %u\n", PORT);
+        return 1;
+    }
+    fcntl(listener, F_SETFL, fcntl(listener, F_GETFL, 0) | O_NONBLOCK);
+
+    std::atomic<bool> stop = false;
+    std::thread flooder(flood, listener, std::cref(stop));
+
+    // Outlive the clients, the worker task must not touch them anymore either way
+    std::vector<std::unique_ptr<ClientState>> states;
+    std::size_t timedOut = 0;
+
+    for (std::size_t round = 0; round < ROUNDS; ++round) {
+        std::vector<std::pair<AsyncClient*, ClientState*>> clients;
+        for (std::size_t i = 0; i < CLIENTS; ++i) {
+            ClientState* state =
+                states.emplace_back(std::make_unique<ClientState>()).get();
+            auto* client = new AsyncClient();
+            client->onData([state](void*, AsyncClient* c, void*, std::size_t) {
+                state->inCallback = true;
+                if (state->deleted) {
+                    ++callbacksAfterDelete;
+                }
+                ++dataCallbacks;
+                state->receiving = true;
+
+                // Use the client while the application may be deleting it
+                const auto until = std::chrono::steady_clock::now() + 20us;
+                while (std::chrono::steady_clock::now() < until) {
+                    static_cast<void>(c->space());
+                }
+                if (!c->connected()) {
+                    ++closedDuringCallback;
+                }
+                state->inCallback = false;
+            });
+            client->onError([](void*, AsyncClient*, int) { ++errors; });
+            client->connect(IPAddress(127, 0, 0, 1), PORT);
+            clients.emplace_back(client, state);
+        }
+
+        if (!waitFor([&] {
+                for (const auto& [client, state] : clients) {
+                    if (!state->receiving) {
+                        return false;
+                    }
+                }
+                return true;
+            })) {
+            ++timedOut;
+        }
+
+        for (const auto& [client, state] : clients) {
+            delete client;
+            if (state->inCallback) {
+                ++callbacksAfterDelete;
+            }
+            state->deleted = true;
+        }
+    }
+
+    // Anything still queued for the deleted clients would run now
+    std::this_thread::sleep_for(100ms);
+    stop = true;
+    flooder.join();
+    ::close(listener);
+
+    std::printf("%zu data callbacks, %zu rounds timed out\n", dataCallbacks.load(),
+                timedOut);
+    if (callbacksAfterDelete > 0 || closedDuringCallback > 0 || errors > 0 ||
+        dataCallbacks == 0) {
+        std::printf(
+            "%zu callbacks ran after their client was deleted, %zu saw it closed, %zu "
+            "errors\n",
+            callbacksAfterDelete.load(), closedDuringCallback.load(), errors.load());
+        return 1;
+    }
+    std::printf("passed\n");
+    return 0;
+}
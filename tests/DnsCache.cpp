@@ -0,0 +1,179 @@
+// DnsCache against the host's resolver, which answers localhost from /etc/hosts. The
+// test interposes getaddrinfo() to count lookups and to slow them down, so that
+// concurrent requests find the first one in progress. Names in .invalid fail right away
+// without asking the resolver.
+//
+// Concurrent requests share one lookup, results are reused until the TTL passes and
+// failures until the negative TTL passes.
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <dlfcn.h>
+#include <netdb.h>
+
+#include <DnsCache.hpp>
+
+using namespace AsyncTcpSock;
+using namespace std::chrono_literals;
+
+namespace {
+
+std::atomic<std::size_t> failures = 0;
+
+#define CHECK(condition)                                                           \
+    do {                                                                           \
+        if (!(condition)) {                                                        \
+            std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, \
+                         #condition);                                              \
+            ++failures;                                                            \
+        }                                                                          \
+    } while (false)
+
+constexpr auto LOOKUP_TIME = 100ms;
+constexpr auto TTL = 500ms;
+constexpr auto NEGATIVE_TTL = 300ms;
+
+std::atomic<std::size_t> localhostLookups = 0;
+std::atomic<std::size_t> invalidLookups = 0;
+
+struct Request {
+    std::atomic<bool> done = false;
+    std::atomic<bool> resolved = false;
+    bool loopback = false;
+};
+
+void found(const DnsAddresses* addresses, void* arg) {
+    auto& request = *static_cast<Request*>(arg);
+    if (addresses != nullptr) {
+        const IPAddress ip4Loopback(127, 0, 0, 1);
+        for (const IPAddress& address : addresses->span()) {
+            request.loopback |= address == ip4Loopback ||
+                                (address.type() == IPv6 && address[15] == 1);
+        }
+        request.resolved = true;
+    }
+    request.done = true;
+}
+
+bool waitFor(Request& request) {
+    const auto deadline = std::chrono::steady_clock::now() + 10s;
+    while (!request.done) {
+        if (std::chrono::steady_clock::now() > deadline) {
+            return false;
+        }
+        std::this_thread::sleep_for(1ms);
+    }
+    return true;
+}
+
+Platform::DnsStatus resolve(const char* host, Request& request) {
+    DnsAddresses resolved;
+    const Platform::DnsStatus status =
+        DnsCache::instance().resolve(host, resolved, found, &request);
+    if (status == Platform::DnsStatus::RESOLVED) {
+        found(&resolved, &request);
+    }
+    return status;
+}
+
+void testLocalhost() {
+    constexpr std::size_t THREADS = 8;
+    std::vector<Request> requests(THREADS);
+    std::vector<Platform::DnsStatus> statuses(THREADS);
+    std::atomic<std::size_t> ready = 0;
+    std::vector<std::thread> threads;
+    for (std::size_t i = 0; i < THREADS; ++i) {
+        threads.emplace_back([&, i]() {
+            ++ready;
+            while (ready < THREADS) {
+                std::this_thread::yield();
+            }
+            statuses[i] = resolve("localhost", requests[i]);
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+
+    // All of them waited for the one lookup
+    for (std::size_t i = 0; i < THREADS; ++i) {
+        CHECK(statuses[i] == Platform::DnsStatus::IN_PROGRESS);
+        CHECK(waitFor(requests[i]));
+        CHECK(requests[i].resolved && requests[i].loopback);
+    }
+    CHECK(localhostLookups == 1);
+
+    // Cached
+    Request cached;
+    CHECK(resolve("localhost", cached) == Platform::DnsStatus::RESOLVED);
+    CHECK(cached.resolved && cached.loopback);
+    CHECK(localhostLookups == 1);
+
+    // Looked up again once expired
+    std::this_thread::sleep_for(TTL);
+    Request expired;
+    CHECK(resolve("localhost", expired) == Platform::DnsStatus::IN_PROGRESS);
+    CHECK(waitFor(expired) && expired.resolved);
+    CHECK(localhostLookups == 2);
+}
+
+void testFailure() {
+    Request first;
+    CHECK(resolve("missing.invalid", first) == Platform::DnsStatus::IN_PROGRESS);
+    CHECK(waitFor(first) && !first.resolved);
+    CHECK(invalidLookups == 1);
+
+    // The failure is cached
+    Request cached;
+    CHECK(resolve("missing.invalid", cached) == Platform::DnsStatus::FAILED);
+    CHECK(invalidLookups == 1);
+
+    // For the negative TTL only
+    std::this_thread::sleep_for(NEGATIVE_TTL);
+    Request expired;
+    CHECK(resolve("missing.invalid", expired) == Platform::DnsStatus::IN_PROGRESS);
+    CHECK(waitFor(expired) && !expired.resolved);
+    CHECK(invalidLookups == 2);
+}
+
+}  // namespace
+
+// Runs on the resolver's threads in place of the C library's
+extern "C" int getaddrinfo(const char* node,
+                           const char* service,
+                           const addrinfo* hints,
+                           addrinfo** res) {
+    using GetAddrInfo = int (*)(const char*, const char*, const addrinfo*, addrinfo**);
+    static const auto next =
+        reinterpret_cast<GetAddrInfo>(dlsym(RTLD_NEXT, "getaddrinfo"));
+
+    if (node != nullptr && std::string_view(node).ends_with(".invalid")) {
+        ++invalidLookups;
+        return EAI_NONAME;
+    }
+    if (node != nullptr && std::strcmp(node, "localhost") == 0) {
+        ++localhostLookups;
+        std::this_thread::sleep_for(LOOKUP_TIME);
+    }
+    return next(node, service, hints, res);
+}
+
+int main() {
+    DnsCache::instance().setTtl(TTL, NEGATIVE_TTL);
+
+    testLocalhost();
+    testFailure();
+
+    if (failures > 0) {
+        std::printf("%zu checks failed\n", failures.load());
+        return 1;
+    }
+    std::printf("passed\n");
+    return 0;
+}
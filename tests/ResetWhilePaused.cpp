@@ -0,0 +1,107 @@
+// A peer resetting a connection whose client doesn't read its socket at the moment. The
+// client only has read interest for the socket again once the application catches up, but
+// the reset must be reported right away rather than spinning the worker task.
+//
+// The server side is a plain socket that sends more than the client takes, then resets
+// the connection with unread data in the client's socket.
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <AsyncTCP.h>
+
+using namespace std::chrono_literals;
+
+namespace {
+
+constexpr std::uint16_t PORT = 47102;
+
+template <class Predicate>
+bool waitFor(Predicate&& predicate, std::chrono::steady_clock::duration timeout = 10s) {
+    const auto deadline = std::chrono::steady_clock::now() + timeout;
+    while (!predicate()) {
+        if (std::chrono::steady_clock::now() > deadline) {
+            return false;
+        }
+        std::this_thread::sleep_for(1ms);
+    }
+    return true;
+}
+
+// Connects a client configured by setup(), fills it up, then resets the connection.
+// Returns whether the client noticed within a second.
+bool resetWhilePaused(int listener, const std::function<void(AsyncClient&)>& setup) {
+    std::atomic<bool> failed = false;
+    auto client = std::make_unique<AsyncClient>();
+    setup(*client);
+    client->onError([&](void*, AsyncClient*, int) { failed = true; });
+    client->onDisconnect([&](void*, AsyncClient*) { failed = true; });
+    client->connect(IPAddress(127, 0, 0, 1), PORT);
+
+    const int peer = accept(listener, nullptr, nullptr);
+    if (peer < 0) {
+        return false;
+    }
+    const std::vector<char> payload(64 * 1024);
+    send(peer, payload.data(), payload.size(), MSG_NOSIGNAL);
+    // Until the client has stopped reading
+    std::this_thread::sleep_for(100ms);
+
+    const linger reset{.l_onoff = 1, .l_linger = 0};
+    setsockopt(peer, SOL_SOCKET, SO_LINGER, &reset, sizeof(reset));
+    ::close(peer);
+
+    return waitFor([&] { return failed.load(); }, 1s);
+}
+
+}  // namespace
+
+int main() {
+    const int listener = socket(AF_INET, SOCK_STREAM, 0);
+    const int reuse = 1;
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    const sockaddr_in addr{.sin_family = AF_INET,
+                           .sin_port = htons(PORT),
+                           .sin_addr = {.s_addr = htonl(INADDR_LOOPBACK)},
+                           .sin_zero = {}};
+    if (bind(listener, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) < 0 ||
+        listen(listener, 8) < 0) {
+        std::printf("failed to listen on port %u\n", PORT);
+        return 1;
+    }
+
+    bool passed = true;
+
+    // Pull mode with a ring that is full and never read
+    if (!resetWhilePaused(listener,
+                          [](AsyncClient& client) { client.setReceiveBuffer(256); })) {
+        std::printf("reset with a full receive ring wasn't reported\n");
+        passed = false;
+    }
+
+    // Acknowledgements deferred past the watermark
+    if (!resetWhilePaused(listener, [](AsyncClient& client) {
+            client.setAckWatermark(0);
+            client.onData(
+                [](void*, AsyncClient* c, void*, std::size_t) { c->ackLater(); });
+        })) {
+        std::printf("reset with deferred acknowledgements wasn't reported\n");
+        passed = false;
+    }
+
+    ::close(listener);
+    if (!passed) {
+        return 1;
+    }
+    std::printf("passed\n");
+    return 0;
+}